@@ -0,0 +1,342 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "BallisticProjectileSubsystem.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/DamageType.h"
+#include "Kismet/GameplayStatics.h"
+#include "Particles/ParticleSystem.h"
+#include "Sound/SoundBase.h"
+#include "LoadTestStats.h"
+#include "EffectBudgetSubsystem.h"
+#include "DestructionSubsystem.h"
+#include "HitchCapture.h"
+
+static TAutoConsoleVariable<int32> CVarProjectilesSimulateInNetGames
+(
+	TEXT("CrazyTank.Projectiles.SimulateInNetGames"),
+	0,
+	TEXT("The simulated projectiles aren't replicated, so networked games fire projectile Actors instead.\n")
+	TEXT("1: simulate them in networked games too (only for server load tests, clients won't see them)."),
+	ECVF_Default
+);
+
+/*
+
+	FBallisticProjectileParams
+
+*/
+
+bool FBallisticProjectileParams::operator==(const FBallisticProjectileParams& Other) const
+{
+	return Speed == Other.Speed
+		&& GravityScale == Other.GravityScale
+		&& LifeSeconds == Other.LifeSeconds
+		&& CollisionRadius == Other.CollisionRadius
+		&& TraceChannel == Other.TraceChannel
+		&& Damage == Other.Damage
+		&& DamageType == Other.DamageType
+		&& DamageRadius == Other.DamageRadius
+		&& MinimumDamage == Other.MinimumDamage
+		&& Mesh == Other.Mesh
+		&& MeshScale == Other.MeshScale
+		&& HitParticle == Other.HitParticle
+		&& HitSound == Other.HitSound;
+}
+
+/*
+
+	UBallisticProjectileSubsystem
+
+*/
+
+////////		Returns the index to fire this kind of projectile with, equal kinds share the same index		////////
+int32 UBallisticProjectileSubsystem::RegisterProjectileType(const FBallisticProjectileParams& Params)
+{
+	// Every Turret registers its projectile, but most of them share the same settings
+	int32 TypeIndex = ProjectileTypes.IndexOfByKey(Params);
+	if (TypeIndex != INDEX_NONE)
+	{
+		return TypeIndex;
+	}
+
+	TypeIndex = ProjectileTypes.Add(Params);
+	TypeVisuals.AddVisual(GetWorld(), Params.Mesh);
+
+	return TypeIndex;
+}
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////		Adds a projectile of a registered kind, moving forward from the given transform		////////
+void UBallisticProjectileSubsystem::FireProjectile(int32 TypeIndex, const FVector& Location, const FRotator& Rotation, AActor* ProjectileOwner)
+{
+	if (!ProjectileTypes.IsValidIndex(TypeIndex))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Trying to fire an unregistered ballistic projectile type %d"), TypeIndex);
+		return;
+	}
+
+	const FBallisticProjectileParams& Params = ProjectileTypes[TypeIndex];
+
+	Positions.Add(Location);
+	Velocities.Add(Rotation.Vector() * Params.Speed);
+	RemainingLife.Add(Params.LifeSeconds);
+	TypeIndices.Add(TypeIndex);
+	Owners.Add(ProjectileOwner);
+	SweepHandles.Add(FTraceHandle()); // Its first sweep is started at the end of this frame's tick
+
+	// A projectile fired while hits are being dispatched (e.g. from a destruction) must line up with the current frame's flags
+	IsDead.Add(false);
+}
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////		How many projectiles are flying right now		////////
+int32 UBallisticProjectileSubsystem::GetProjectileCount() const
+{
+	return Positions.Num();
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Advances every projectile and resolves its hits		////////
+void UBallisticProjectileSubsystem::Tick(float DeltaTime)
+{
+	FLoadTestScope LoadTestScope(ELoadTestSystem::Projectiles);
+	CRAZYTANK_HITCH_SCOPE("Projectiles.Tick");
+
+	// The sweeps started last frame ran alongside the rest of that frame, their hits are resolved before moving on
+	GatherSweepResults();
+	DispatchImpacts();
+	RemoveDeadProjectiles();
+
+	Advance(DeltaTime);
+	StartSweeps();
+	UpdateVisuals();
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Moves every projectile and applies its gravity		////////
+void UBallisticProjectileSubsystem::Advance(float DeltaTime)
+{
+	const float GravityZ = GetWorld()->GetGravityZ();
+	const int32 ProjectileCount = Positions.Num();
+
+	SegmentStarts.SetNumUninitialized(ProjectileCount, false);
+
+	for (int32 Index = 0; Index < ProjectileCount; Index++)
+	{
+		SegmentStarts[Index] = Positions[Index];
+		Velocities[Index].Z += GravityZ * ProjectileTypes[TypeIndices[Index]].GravityScale * DeltaTime;
+		Positions[Index] += Velocities[Index] * DeltaTime;
+		RemainingLife[Index] -= DeltaTime;
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Starts the async sweep of every projectile from where it was to where it is now		////////
+void UBallisticProjectileSubsystem::StartSweeps()
+{
+	UWorld* World = GetWorld();
+
+	for (int32 Index = 0; Index < Positions.Num(); Index++)
+	{
+		const FBallisticProjectileParams& Params = ProjectileTypes[TypeIndices[Index]];
+
+		// The projectile's owner is ignored, the same way the projectile Actors ignore the Pawn that fired them
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(BallisticProjectile), false, Owners[Index].Get());
+
+		// Async sweeps are batched by the engine and run on worker threads while the rest of the frame goes on,
+		// instead of every projectile blocking the game thread with its own query
+		if (Params.CollisionRadius > 0.0f)
+		{
+			SweepHandles[Index] = World->AsyncSweepByChannel
+			(
+				EAsyncTraceType::Single,
+				SegmentStarts[Index],
+				Positions[Index],
+				FQuat::Identity,
+				Params.TraceChannel,
+				FCollisionShape::MakeSphere(Params.CollisionRadius),
+				QueryParams
+			);
+		}
+		else
+		{
+			SweepHandles[Index] = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, SegmentStarts[Index], Positions[Index], Params.TraceChannel, QueryParams);
+		}
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Reads the hits of the sweeps started last frame		////////
+void UBallisticProjectileSubsystem::GatherSweepResults()
+{
+	UWorld* World = GetWorld();
+	const int32 ProjectileCount = Positions.Num();
+
+	Impacts.Reset();
+	IsDead.Reset();
+	IsDead.SetNumZeroed(ProjectileCount, false);
+
+	for (int32 Index = 0; Index < ProjectileCount; Index++)
+	{
+		// A hit is found one frame after the projectile crossed it, the projectile is moved back to it when dispatched
+		if (SweepHandles[Index].IsValid() && World->QueryTraceData(SweepHandles[Index], SweepResult) && SweepResult.OutHits.Num() > 0
+			&& SweepResult.OutHits[0].bBlockingHit)
+		{
+			Impacts.Add({ Index, SweepResult.OutHits[0] });
+		}
+		SweepHandles[Index] = FTraceHandle();
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Applies damage and plays hit effects for every projectile that hit something		////////
+void UBallisticProjectileSubsystem::DispatchImpacts()
+{
+	const bool bDrawEffects = ShouldDrawEffects();
+	UEffectBudgetSubsystem* EffectBudget = GetWorld()->GetSubsystem<UEffectBudgetSubsystem>();
+	UDestructionSubsystem* DestructionSubsystem = GetWorld()->GetSubsystem<UDestructionSubsystem>();
+
+	for (const FBallisticImpact& Impact : Impacts)
+	{
+		const int32 Index = Impact.ProjectileIndex;
+		const FBallisticProjectileParams& Params = ProjectileTypes[TypeIndices[Index]];
+		AActor* ProjectileOwner = Owners[Index].Get();
+		AActor* HitActor = Impact.Hit.GetActor();
+
+		IsDead[Index] = true;
+		Positions[Index] = Impact.Hit.Location;
+
+		if (ProjectileOwner && Params.DamageRadius > 0.0f && DestructionSubsystem)
+		{
+			// Exploding projectiles damage everything around the impact with one overlap query (never the Pawn that fired)
+			DestructionSubsystem->ApplyRadialDamage
+			(
+				Impact.Hit.Location,
+				Params.DamageRadius,
+				Params.Damage,
+				Params.MinimumDamage,
+				ProjectileOwner,
+				ProjectileOwner->GetInstigatorController(),
+				Params.DamageType
+			);
+		}
+		else if (HitActor && ProjectileOwner && HitActor != ProjectileOwner)
+		{
+			// With no projectile Actor, the Pawn that fired is the damage causer
+			UGameplayStatics::ApplyDamage(HitActor, Params.Damage, ProjectileOwner->GetInstigatorController(), ProjectileOwner, Params.DamageType);
+		}
+
+		if (bDrawEffects)
+		{
+			// Impact effects are budgeted, a volley hitting a wall doesn't spawn one particle system per projectile
+			if (Params.HitParticle && EffectBudget)
+			{
+				EffectBudget->SpawnOneShot(EEffectCategory::Impact, Params.HitParticle, Impact.Hit.Location, Impact.Hit.ImpactNormal.Rotation());
+			}
+
+			if (Params.HitSound)
+			{
+				UGameplayStatics::PlaySoundAtLocation(this, Params.HitSound, Impact.Hit.Location);
+			}
+		}
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Removes the projectiles that hit something or ran out of life		////////
+void UBallisticProjectileSubsystem::RemoveDeadProjectiles()
+{
+	// Going backwards, so swapping the last projectile into a removed slot never skips one
+	for (int32 Index = Positions.Num() - 1; Index >= 0; Index--)
+	{
+		if (IsDead[Index] || RemainingLife[Index] <= 0.0f)
+		{
+			RemoveProjectileAtSwap(Index);
+		}
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+void UBallisticProjectileSubsystem::RemoveProjectileAtSwap(int32 Index)
+{
+	Positions.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	RemainingLife.RemoveAtSwap(Index, 1, false);
+	TypeIndices.RemoveAtSwap(Index, 1, false);
+	Owners.RemoveAtSwap(Index, 1, false);
+	SweepHandles.RemoveAtSwap(Index, 1, false);
+	IsDead.RemoveAtSwap(Index, 1, false);
+}
+
+////////		Moves the instanced meshes to where the projectiles are		////////
+void UBallisticProjectileSubsystem::UpdateVisuals()
+{
+	for (int32 TypeIndex = 0; TypeIndex < ProjectileTypes.Num(); TypeIndex++)
+	{
+		if (!TypeVisuals.HasVisual(TypeIndex))
+		{
+			continue;
+		}
+
+		const FBallisticProjectileParams& Params = ProjectileTypes[TypeIndex];
+
+		TArray<FTransform>& InstanceTransforms = TypeVisuals.ResetInstanceTransforms();
+		for (int32 Index = 0; Index < Positions.Num(); Index++)
+		{
+			if (TypeIndices[Index] == TypeIndex)
+			{
+				InstanceTransforms.Emplace(Velocities[Index].Rotation(), Positions[Index], Params.MeshScale);
+			}
+		}
+
+		TypeVisuals.UpdateVisual(TypeIndex);
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		False in networked games (unless a load test asks for it), the simulation isn't replicated		////////
+bool UBallisticProjectileSubsystem::IsSimulationAllowed() const
+{
+	UWorld* World = GetWorld();
+	return World && (World->GetNetMode() == NM_Standalone || CVarProjectilesSimulateInNetGames.GetValueOnGameThread() != 0);
+}
+////////////////////////////////////////////////////////////////////////
+
+bool UBallisticProjectileSubsystem::ShouldDrawEffects() const
+{
+	UWorld* World = GetWorld();
+	return World && World->GetNetMode() != NM_DedicatedServer;
+}
+
+////////		Called when the world is torn down		////////
+void UBallisticProjectileSubsystem::Deinitialize()
+{
+	Positions.Empty();
+	Velocities.Empty();
+	RemainingLife.Empty();
+	TypeIndices.Empty();
+	Owners.Empty();
+	SweepHandles.Empty();
+	TypeVisuals.Reset();
+
+	Super::Deinitialize();
+}
+////////////////////////////////////////////////////////////////////////
+
+bool UBallisticProjectileSubsystem::HasWorkToTick() const
+{
+	return GetProjectileCount() > 0;
+}
+
+TStatId UBallisticProjectileSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBallisticProjectileSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,190 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CrazyTankTickableWorldSubsystem.h"
+#include "Engine/EngineTypes.h"
+#include "WorldCollision.h"
+#include "InstancedVisualPool.h"
+#include "BallisticProjectileSubsystem.generated.h"
+
+/*
+
+	Engine classes
+
+*/
+
+class UDamageType;
+class UParticleSystem;
+class USoundBase;
+class UStaticMesh;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Everything needed to simulate, draw and resolve the hits of one kind of regular projectile
+//
+//////////////////////////////////////////////////////////////////////////////
+USTRUCT(BlueprintType)
+struct CRAZYTANK_API FBallisticProjectileParams
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement")
+	float Speed = 1300.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement")
+	float GravityScale = 0.0f; // 0 makes the projectile fly straight, 1 makes it fall with the world's gravity
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement")
+	float LifeSeconds = 3.0f; // The projectile disappears after this time if it didn't hit anything
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision")
+	float CollisionRadius = 0.0f; // 0 sweeps a line, anything greater sweeps a sphere of this radius
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collision")
+	TEnumAsByte<ECollisionChannel> TraceChannel = ECollisionChannel::ECC_Visibility;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Damage")
+	float Damage = 50.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Damage")
+	TSubclassOf<UDamageType> DamageType;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Damage", meta = (ClampMin = "0"))
+	float DamageRadius = 0.0f; // 0 only damages what was hit, anything greater makes the impact explode with this radius
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Damage", meta = (EditCondition = "DamageRadius > 0"))
+	float MinimumDamage = 0.0f; // Explosion damage at the radius' edge, it goes up linearly to Damage at the impact
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Effects")
+	UStaticMesh* Mesh = nullptr; // Drawn with one instanced mesh component for every projectile of this kind
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Effects")
+	FVector MeshScale = FVector::OneVector;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Effects")
+	UParticleSystem* HitParticle = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Effects")
+	USoundBase* HitSound = nullptr;
+
+	bool operator==(const FBallisticProjectileParams& Other) const;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This class simulates the regular projectiles of Tanks and Turrets without spawning an Actor for each one:
+// every projectile is a few entries in contiguous arrays, advanced and swept all together once per frame.
+// The sweeps are async, so a hit is resolved one frame after the projectile went through it.
+// Nothing is replicated: networked games fire projectile Actors instead (see IsSimulationAllowed())
+//
+//////////////////////////////////////////////////////////////////////////////
+UCLASS()
+class CRAZYTANK_API UBallisticProjectileSubsystem : public UCrazyTankTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	UPROPERTY()
+	TArray<FBallisticProjectileParams> ProjectileTypes; // Every kind of projectile registered by the Pawns
+
+	UPROPERTY()
+	FInstancedVisualPool TypeVisuals; // One instanced mesh per projectile kind
+
+	// Live projectiles, one entry per projectile at the same index in every array
+	TArray<FVector> Positions;
+
+	TArray<FVector> Velocities;
+
+	TArray<float> RemainingLife;
+
+	TArray<int32> TypeIndices;
+
+	TArray<TWeakObjectPtr<AActor>> Owners; // The Pawn that fired, it's never hit by its own projectiles
+
+	TArray<FTraceHandle> SweepHandles; // Async sweep started last frame for the segment the projectile flew through
+
+	// A projectile that hit something this frame
+	struct FBallisticImpact
+	{
+		int32 ProjectileIndex;
+
+		FHitResult Hit;
+	};
+
+	// Scratch arrays kept between frames so the simulation doesn't allocate once it has warmed up
+	TArray<FVector> SegmentStarts;
+
+	TArray<FBallisticImpact> Impacts;
+
+	TArray<bool> IsDead;
+
+	FTraceDatum SweepResult;
+
+	/*
+		METHODS
+	*/
+
+	void Advance(float DeltaTime); // Moves every projectile and applies its gravity
+
+	void StartSweeps(); // Starts the async sweep of every projectile from where it was to where it is now
+
+	void GatherSweepResults(); // Reads the hits of the sweeps started last frame
+
+	void DispatchImpacts(); // Applies damage and plays hit effects for every projectile that hit something
+
+	void RemoveDeadProjectiles(); // Removes the projectiles that hit something or ran out of life
+
+	void UpdateVisuals(); // Moves the instanced meshes to where the projectiles are
+
+	void RemoveProjectileAtSwap(int32 Index);
+
+	bool ShouldDrawEffects() const; // Dedicated servers simulate and damage, but don't draw anything
+
+public:
+
+	/*
+		METHODS
+	*/
+
+	// Returns the index to fire this kind of projectile with, equal kinds share the same index
+	int32 RegisterProjectileType(const FBallisticProjectileParams& Params);
+
+	// Adds a projectile of a registered kind, moving forward from the given transform
+	void FireProjectile(int32 TypeIndex, const FVector& Location, const FRotator& Rotation, AActor* ProjectileOwner);
+
+	int32 GetProjectileCount() const; // How many projectiles are flying right now
+
+	bool IsSimulationAllowed() const; // False in networked games (unless a load test asks for it), Pawns fire projectile Actors instead
+
+	virtual void Deinitialize() override; // Called when the world is torn down
+
+	/*
+		FTickableGameObject interface
+	*/
+
+	virtual void Tick(float DeltaTime) override; // Advances every projectile and resolves its hits
+
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/*
+		METHODS
+	*/
+
+	virtual bool HasWorkToTick() const override; // While projectiles are flying
+
+};
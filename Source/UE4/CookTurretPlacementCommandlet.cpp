@@ -0,0 +1,250 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "CookTurretPlacementCommandlet.h"
+#include "Algo/Find.h"
+#include "Engine/Level.h"
+#include "Engine/LevelStreaming.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "CrazyTank/Actors/PickUpBase.h"
+#include "PawnTurret.h"
+#include "TurretPlacementSpawner.h"
+#include "TurretPlacementTable.h"
+
+UCookTurretPlacementCommandlet::UCookTurretPlacementCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+////////		Cooks the placement table of every map in -Maps=		////////
+int32 UCookTurretPlacementCommandlet::Main(const FString& Params)
+{
+	FString MapsParam;
+	if (!FParse::Value(*Params, TEXT("Maps="), MapsParam, false))
+	{
+		UE_LOG(LogTemp, Error, TEXT("CookTurretPlacement: no maps given, use -Maps=/Game/Maps/Level1+/Game/Maps/Level2"));
+		return 1;
+	}
+
+	TArray<FString> MapNames;
+	MapsParam.ParseIntoArray(MapNames, TEXT("+"));
+
+	int32 FailedMaps = 0;
+	for (const FString& MapName : MapNames)
+	{
+		if (!CookMap(MapName))
+		{
+			FailedMaps++;
+		}
+	}
+
+	return FailedMaps == 0 ? 0 : 1;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Writes the placement tables of one map and of its streamed levels		////////
+bool UCookTurretPlacementCommandlet::CookMap(const FString& MapName)
+{
+#if WITH_EDITORONLY_DATA
+	UPackage* MapPackage = LoadPackage(nullptr, *MapName, LOAD_None);
+	UWorld* World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if (!World || !World->PersistentLevel)
+	{
+		UE_LOG(LogTemp, Error, TEXT("CookTurretPlacement: couldn't load map %s"), *MapName);
+		return false;
+	}
+
+	// The table is named after the loaded package, -Maps= could also give a short name or a filename
+	bool bCooked = CookLevel(World->PersistentLevel, MapPackage->GetName());
+
+	// Every streamed level is cooked on its own (and stripped of its baked Turrets on its own),
+	// so its Turrets are spawned by a spawner in that level, and only while it's loaded
+	for (ULevelStreaming* StreamingLevel : World->GetStreamingLevels())
+	{
+		if (!StreamingLevel)
+		{
+			continue;
+		}
+
+		FString LevelName = StreamingLevel->GetWorldAssetPackageName();
+		UPackage* LevelPackage = LoadPackage(nullptr, *LevelName, LOAD_None);
+		UWorld* LevelWorld = LevelPackage ? UWorld::FindWorldInPackage(LevelPackage) : nullptr;
+		if (!LevelWorld || !LevelWorld->PersistentLevel)
+		{
+			UE_LOG(LogTemp, Error, TEXT("CookTurretPlacement: couldn't load level %s streamed by %s"), *LevelName, *MapName);
+			bCooked = false;
+			continue;
+		}
+
+		bCooked &= CookLevel(LevelWorld->PersistentLevel, LevelName);
+	}
+
+	return bCooked;
+#else
+	// The bake flag only exists in editor builds
+	UE_LOG(LogTemp, Error, TEXT("CookTurretPlacement: must be run from the editor"));
+	return false;
+#endif
+}
+////////////////////////////////////////////////////////////////////////
+
+#if WITH_EDITORONLY_DATA
+////////		Writes the placement table of one level		////////
+bool UCookTurretPlacementCommandlet::CookLevel(ULevel* Level, const FString& LevelName)
+{
+	TArray<FTurretPlacementRecord> Records;
+	TArray<uint16> PickUpIndices;
+	TArray<FString> ClassPaths; // Turret and Pick Up classes, each one stored once
+	bool bHasSpawner = false;
+	bool bAllBakeable = true;
+
+	for (AActor* Actor : Level->Actors)
+	{
+		bHasSpawner |= Cast<ATurretPlacementSpawner>(Actor) != nullptr;
+
+		APawnTurret* Turret = Cast<APawnTurret>(Actor);
+		if (!Turret || !Turret->bBakeIntoPlacementTable)
+		{
+			continue;
+		}
+
+		if (!CanBakeTurret(Turret))
+		{
+			bAllBakeable = false;
+			continue;
+		}
+
+		FTurretPlacementRecord Record;
+		FMemory::Memzero(Record);
+
+		FTransform TurretTransform = Turret->GetActorTransform();
+		Record.Location = TurretTransform.GetLocation();
+		Record.Rotation = TurretTransform.Rotator();
+		Record.Scale = TurretTransform.GetScale3D();
+		Record.FireRange = Turret->FireRange;
+		Record.FireRate = Turret->FireRate;
+		Record.AimProjectileSpeed = Turret->AimProjectileSpeed;
+		Record.AimTurnRate = Turret->AimTurnRate;
+		Record.MinAimPitch = Turret->MinAimPitch;
+		Record.MaxAimPitch = Turret->MaxAimPitch;
+		Record.Flags = ETurretPlacementFlags::None;
+		if (Turret->bUseBallisticProjectiles)
+		{
+			Record.Flags |= ETurretPlacementFlags::UseBallisticProjectiles;
+		}
+		if (Turret->bUseLightweightPickUps)
+		{
+			Record.Flags |= ETurretPlacementFlags::UseLightweightPickUps;
+		}
+		Record.ClassIndex = (uint16)ClassPaths.AddUnique(Turret->GetClass()->GetPathName());
+		Record.FirstPickUp = PickUpIndices.Num();
+
+		for (const TSubclassOf<APickUpBase>& PickUp : Turret->PickUpClass)
+		{
+			if (*PickUp)
+			{
+				PickUpIndices.Add((uint16)ClassPaths.AddUnique(PickUp->GetPathName()));
+				Record.NumPickUps++;
+			}
+		}
+
+		Records.Add(Record);
+	}
+
+	// A Turret whose settings can't be baked would come back different in the cooked game, so nothing is written
+	if (!bAllBakeable)
+	{
+		UE_LOG(LogTemp, Error, TEXT("CookTurretPlacement: %s has Turrets that can't be baked, its placement table wasn't written"), *LevelName);
+		return false;
+	}
+
+	if (ClassPaths.Num() > MAX_uint16)
+	{
+		UE_LOG(LogTemp, Error, TEXT("CookTurretPlacement: %s uses more classes than a placement table can index"), *LevelName);
+		return false;
+	}
+
+	FString TableFilename = FTurretPlacementTable::GetTableFilename(LevelName);
+	if (Records.Num() == 0)
+	{
+		// Nothing baked in this level, a table left over from an older bake would spawn Turrets that aren't there anymore
+		IFileManager::Get().Delete(*TableFilename, false, false, true);
+		return true;
+	}
+
+	if (!bHasSpawner)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("CookTurretPlacement: %s has baked Turrets but no Turret Placement Spawner, they won't be spawned in the cooked game"), *LevelName);
+	}
+
+	if (!FTurretPlacementTable::Save(TableFilename, Records, PickUpIndices, ClassPaths))
+	{
+		UE_LOG(LogTemp, Error, TEXT("CookTurretPlacement: couldn't write %s"), *TableFilename);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("CookTurretPlacement: baked %d Turrets of %s into %s"), Records.Num(), *LevelName, *TableFilename);
+	return true;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		False (and logs why) if the Turret has settings the table doesn't store		////////
+bool UCookTurretPlacementCommandlet::CanBakeTurret(const APawnTurret* Turret) const
+{
+	// Settings stored in the placement record, they can be set per Turret
+	static const FName BakedProperties[] =
+	{
+		GET_MEMBER_NAME_CHECKED(APawnTurret, FireRange),
+		GET_MEMBER_NAME_CHECKED(APawnTurret, FireRate),
+		GET_MEMBER_NAME_CHECKED(APawnTurret, PickUpClass),
+		GET_MEMBER_NAME_CHECKED(APawnTurret, AimProjectileSpeed),
+		GET_MEMBER_NAME_CHECKED(APawnTurret, AimTurnRate),
+		GET_MEMBER_NAME_CHECKED(APawnTurret, MinAimPitch),
+		GET_MEMBER_NAME_CHECKED(APawnTurret, MaxAimPitch),
+		GET_MEMBER_NAME_CHECKED(APawnTurret, bUseBallisticProjectiles),
+		GET_MEMBER_NAME_CHECKED(APawnTurret, bUseLightweightPickUps),
+		GET_MEMBER_NAME_CHECKED(APawnTurret, bBakeIntoPlacementTable)
+	};
+
+	// Every other editable setting of the Pawn classes (e.g. BallisticProjectile, LightweightPickUps, or the ones added
+	// by a Blueprint) is spawned with its class default, so a Turret that changed one of them can't be baked
+	const UObject* ClassDefaults = Turret->GetClass()->GetDefaultObject();
+	bool bCanBake = true;
+
+	for (TFieldIterator<FProperty> PropertyIt(Turret->GetClass()); PropertyIt; ++PropertyIt)
+	{
+		const FProperty* Property = *PropertyIt;
+		if (!Property->HasAnyPropertyFlags(CPF_Edit) || Property->HasAnyPropertyFlags(CPF_EditConst)
+			|| !Property->GetOwnerClass()->IsChildOf(APawnBase::StaticClass())
+			|| Algo::Find(BakedProperties, Property->GetFName()))
+		{
+			continue;
+		}
+
+		if (!Property->Identical_InContainer(Turret, ClassDefaults))
+		{
+			UE_LOG
+			(
+				LogTemp,
+				Error,
+				TEXT("CookTurretPlacement: %s changed %s from its class default, placement tables can't store it (reset it or clear Bake Into Placement Table)"),
+				*Turret->GetPathName(),
+				*Property->GetName()
+			);
+			bCanBake = false;
+		}
+	}
+
+	return bCanBake;
+}
+////////////////////////////////////////////////////////////////////////
+#endif
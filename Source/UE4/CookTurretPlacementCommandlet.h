@@ -0,0 +1,75 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CookTurretPlacementCommandlet.generated.h"
+
+/*
+
+	Engine classes
+
+*/
+
+class ULevel;
+
+/*
+
+	Crazy Tank classes
+
+*/
+
+class APawnTurret;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This commandlet bakes every Turret marked with "Bake Into Placement Table" in the given maps (and in the levels
+// they stream) into a Turret placement table per level (Content/TurretPlacement/<Level package path>.ctt).
+// It must run before cooking those maps, the cooker then leaves the baked Turrets out of them.
+// A table stores the transform, combat, aim and Pick Up settings of every Turret, a Turret that changed any other
+// setting from its class defaults fails the bake
+//
+// Usage:
+//	UE4Editor-Cmd <Project>.uproject -run=CookTurretPlacement -Maps=/Game/Maps/Level1+/Game/Maps/Level2
+//
+// The table directory has to be staged as loose files ("Additional Non-Asset Directories to Copy"),
+// files inside a pak file can't be memory-mapped and are read in full instead
+//
+//////////////////////////////////////////////////////////////////////////////
+UCLASS()
+class CRAZYTANK_API UCookTurretPlacementCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+private:
+
+	/*
+		METHODS
+	*/
+
+	bool CookMap(const FString& MapName); // Writes the placement tables of one map and of its streamed levels
+
+#if WITH_EDITORONLY_DATA
+	bool CookLevel(ULevel* Level, const FString& LevelName); // Writes the placement table of one level
+
+	bool CanBakeTurret(const APawnTurret* Turret) const; // False (and logs why) if the Turret has settings the table doesn't store
+#endif
+
+public:
+
+	/*
+		METHODS
+	*/
+
+	UCookTurretPlacementCommandlet();
+
+	virtual int32 Main(const FString& Params) override; // Cooks the placement table of every map in -Maps=
+
+};
@@ -0,0 +1,32 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "CrazyTankTickableWorldSubsystem.h"
+#include "Engine/World.h"
+
+bool UCrazyTankTickableWorldSubsystem::HasWorkToTick() const
+{
+	return true;
+}
+
+ETickableTickType UCrazyTankTickableWorldSubsystem::GetTickableTickType() const
+{
+	// The class default object must never tick, only the instances living in a world
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UCrazyTankTickableWorldSubsystem::IsTickable() const
+{
+	UWorld* World = GetWorld();
+	return World && World->IsGameWorld() && HasWorkToTick();
+}
+
+UWorld* UCrazyTankTickableWorldSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
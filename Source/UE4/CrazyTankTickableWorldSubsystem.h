@@ -0,0 +1,47 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "CrazyTankTickableWorldSubsystem.generated.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Base of the world subsystems that tick with the game: only the instances living in a game world tick
+// (never the class default object, nor editor worlds), and only on the frames they have work to do
+//
+//////////////////////////////////////////////////////////////////////////////
+UCLASS(Abstract)
+class CRAZYTANK_API UCrazyTankTickableWorldSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+protected:
+
+	/*
+		METHODS
+	*/
+
+	virtual bool HasWorkToTick() const; // Checked every frame, the subsystem doesn't tick while it's false
+
+public:
+
+	/*
+		FTickableGameObject interface
+	*/
+
+	virtual ETickableTickType GetTickableTickType() const override;
+
+	virtual bool IsTickable() const override;
+
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+
+};
@@ -0,0 +1,193 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "DestructionSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/DamageType.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+#include "LoadTestStats.h"
+#include "FrameArena.h"
+#include "HitchCapture.h"
+
+// How many queued destructions can be resolved in a single frame
+static TAutoConsoleVariable<int32> CVarDestructionMaxPerFrame
+(
+	TEXT("CrazyTank.Destruction.MaxPerFrame"),
+	4,
+	TEXT("Maximum number of queued destructions (pick up spawning and Destroy()) resolved per frame."),
+	ECVF_Default
+);
+
+// How much game thread time (in milliseconds) the destruction queue can use in a single frame
+static TAutoConsoleVariable<float> CVarDestructionFrameBudgetMs
+(
+	TEXT("CrazyTank.Destruction.FrameBudgetMs"),
+	1.0f,
+	TEXT("Game thread time budget in milliseconds for resolving queued destructions every frame."),
+	ECVF_Default
+);
+
+////////		Applies damage to every Actor inside the explosion's radius using one sphere overlap query		////////
+void UDestructionSubsystem::ApplyRadialDamage
+(
+	const FVector& Origin,
+	float Radius,
+	float BaseDamage,
+	float MinimumDamage,
+	AActor* DamageCauser,
+	AController* InstigatedBy,
+	TSubclassOf<UDamageType> DamageTypeClass
+)
+{
+	CRAZYTANK_HITCH_SCOPE("Destruction.ApplyRadialDamage");
+
+	UWorld* World = GetWorld();
+	if (!World || Radius <= 0.0f)
+	{
+		return;
+	}
+
+	// The explosion's causer must not damage itself, and we don't need complex collision for this query
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(BatchedRadialDamage), false, DamageCauser);
+
+	// Only Pawns (Tanks and Turrets) and dynamic objects can be damaged
+	FCollisionObjectQueryParams ObjectQueryParams(ECollisionChannel::ECC_Pawn);
+	ObjectQueryParams.AddObjectTypesToQuery(ECollisionChannel::ECC_WorldDynamic);
+
+	// One overlap query for the whole explosion instead of one per damaged Actor
+	OverlapResults.Reset();
+	World->OverlapMultiByObjectType
+	(
+		OverlapResults,
+		Origin,
+		FQuat::Identity,
+		ObjectQueryParams,
+		FCollisionShape::MakeSphere(Radius),
+		QueryParams
+	);
+
+	// Every Actor hit by this explosion lives in the frame arena, given back as soon as the explosion is resolved
+	FFrameArenaScope ArenaScope;
+
+	// An Actor can overlap with several of its components, but it must be damaged only once
+	TFrameSet<AActor*> DamagedActors;
+	DamagedActors.Reserve(OverlapResults.Num());
+	for (const FOverlapResult& Overlap : OverlapResults)
+	{
+		AActor* OverlappedActor = Overlap.GetActor();
+		if (OverlappedActor && OverlappedActor->CanBeDamaged())
+		{
+			DamagedActors.Add(OverlappedActor);
+		}
+	}
+
+	for (AActor* DamagedActor : DamagedActors)
+	{
+		// Linear falloff from the explosion's origin to the radius' edge
+		float DistanceAlpha = FMath::Clamp(FVector::Dist(Origin, DamagedActor->GetActorLocation()) / Radius, 0.0f, 1.0f);
+		float Damage = FMath::Lerp(BaseDamage, MinimumDamage, DistanceAlpha);
+
+		// If this damage destroys the Actor, its HandleDestruction() will only queue the heavy work (see QueueDestruction())
+		UGameplayStatics::ApplyDamage(DamagedActor, Damage, InstigatedBy, DamageCauser, DamageTypeClass);
+	}
+}
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////		Adds a destruction to the queue, it'll be resolved in a later frame within the per-frame budget		////////
+void UDestructionSubsystem::QueueDestruction(AActor* DestroyedActor, FSimpleDelegate Resolve)
+{
+	if (!DestroyedActor || !Resolve.IsBound())
+	{
+		return;
+	}
+
+	FQueuedDestruction& QueuedDestruction = PendingDestructions.AddDefaulted_GetRef();
+	QueuedDestruction.Actor = DestroyedActor;
+	QueuedDestruction.Resolve = MoveTemp(Resolve);
+}
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////		How many destructions are still waiting in the queue		////////
+int32 UDestructionSubsystem::GetPendingDestructionCount() const
+{
+	return PendingDestructions.Num() - PendingHead;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Drains the destruction queue under the per-frame budget		////////
+void UDestructionSubsystem::Tick(float DeltaTime)
+{
+	if (GetPendingDestructionCount() == 0)
+	{
+		return;
+	}
+
+	FLoadTestScope LoadTestScope(ELoadTestSystem::Destruction);
+	CRAZYTANK_HITCH_SCOPE("Destruction.Tick");
+
+	const int32 MaxPerFrame = FMath::Max(1, CVarDestructionMaxPerFrame.GetValueOnGameThread());
+	const double BudgetSeconds = CVarDestructionFrameBudgetMs.GetValueOnGameThread() / 1000.0;
+	const double StartTime = FPlatformTime::Seconds();
+
+	int32 ResolvedCount = 0;
+	while (PendingHead < PendingDestructions.Num())
+	{
+		// At least one destruction is resolved every frame, so the queue always makes progress
+		if (ResolvedCount > 0 && (ResolvedCount >= MaxPerFrame || FPlatformTime::Seconds() - StartTime >= BudgetSeconds))
+		{
+			break;
+		}
+
+		// Move the entry out first, resolving it could queue new destructions and reallocate the array
+		FQueuedDestruction QueuedDestruction = MoveTemp(PendingDestructions[PendingHead]);
+		PendingHead++;
+
+		if (QueuedDestruction.Actor.IsValid())
+		{
+			QueuedDestruction.Resolve.ExecuteIfBound();
+			ResolvedCount++;
+		}
+	}
+
+	if (PendingHead == PendingDestructions.Num())
+	{
+		// Everything was resolved, keep the array's memory for the next chain reaction
+		PendingDestructions.Reset();
+		PendingHead = 0;
+	}
+	else if (PendingHead > 64 && PendingHead * 2 > PendingDestructions.Num())
+	{
+		// Drop the already resolved entries once they are the biggest part of the queue
+		PendingDestructions.RemoveAt(0, PendingHead, false);
+		PendingHead = 0;
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Called when the world is torn down		////////
+void UDestructionSubsystem::Deinitialize()
+{
+	// The world is going away with every Actor on it, there's nothing left worth resolving
+	PendingDestructions.Empty();
+	PendingHead = 0;
+
+	Super::Deinitialize();
+}
+////////////////////////////////////////////////////////////////////////
+
+bool UDestructionSubsystem::HasWorkToTick() const
+{
+	return GetPendingDestructionCount() > 0;
+}
+
+TStatId UDestructionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDestructionSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,100 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CrazyTankTickableWorldSubsystem.h"
+#include "WorldCollision.h"
+#include "DestructionSubsystem.generated.h"
+
+/*
+
+	Engine classes
+
+*/
+
+class AController;
+class UDamageType;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This class resolves explosions (radial damage) with a single overlap query per explosion
+// and spreads the expensive part of every destruction (pick up spawning, Destroy()) across frames
+//
+//////////////////////////////////////////////////////////////////////////////
+UCLASS()
+class CRAZYTANK_API UDestructionSubsystem : public UCrazyTankTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	// A destruction waiting to be resolved: the destroyed Actor and the work to run for it when its turn comes
+	struct FQueuedDestruction
+	{
+		TWeakObjectPtr<AActor> Actor;
+
+		FSimpleDelegate Resolve;
+	};
+
+	TArray<FQueuedDestruction> PendingDestructions; // FIFO queue, entries before PendingHead were already resolved
+
+	int32 PendingHead = 0;
+
+	TArray<FOverlapResult> OverlapResults; // Kept between explosions so the overlap query doesn't allocate every time
+
+public:
+
+	/*
+		METHODS
+	*/
+
+	// Applies damage to every Actor inside the explosion's radius using one sphere overlap query
+	// The damage goes linearly from BaseDamage at the origin to MinimumDamage at the radius' edge.
+	// Used by destroyed Tanks and Turrets and by exploding ballistic projectiles. The projectile Actors ("ProjectileBase")
+	// live outside this module, their explosions are only batched once they call this too
+	void ApplyRadialDamage
+	(
+		const FVector& Origin,
+		float Radius,
+		float BaseDamage,
+		float MinimumDamage,
+		AActor* DamageCauser,
+		AController* InstigatedBy,
+		TSubclassOf<UDamageType> DamageTypeClass
+	);
+
+	// Adds a destruction to the queue, Resolve will be called in a later frame within the per-frame budget
+	void QueueDestruction(AActor* DestroyedActor, FSimpleDelegate Resolve);
+
+	int32 GetPendingDestructionCount() const; // How many destructions are still waiting in the queue
+
+	virtual void Deinitialize() override; // Called when the world is torn down
+
+	/*
+		FTickableGameObject interface
+	*/
+
+	virtual void Tick(float DeltaTime) override; // Drains the destruction queue under the per-frame budget
+
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/*
+		METHODS
+	*/
+
+	virtual bool HasWorkToTick() const override; // While destructions are waiting in the queue
+
+};
@@ -0,0 +1,534 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "EffectBudgetSubsystem.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+#include "Particles/ParticleSystem.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "FrameArena.h"
+#include "HitchCapture.h"
+
+// Concurrent particle systems allowed for every effect category
+static TAutoConsoleVariable<int32> CVarEffectsMaxDustTrails
+(
+	TEXT("CrazyTank.Effects.MaxDustTrails"),
+	16,
+	TEXT("Maximum number of Tank dust trails emitting at once."),
+	ECVF_Scalability
+);
+
+static TAutoConsoleVariable<int32> CVarEffectsMaxDestruction
+(
+	TEXT("CrazyTank.Effects.MaxDestruction"),
+	12,
+	TEXT("Maximum number of destruction effects playing at once."),
+	ECVF_Scalability
+);
+
+static TAutoConsoleVariable<int32> CVarEffectsMaxImpacts
+(
+	TEXT("CrazyTank.Effects.MaxImpacts"),
+	24,
+	TEXT("Maximum number of projectile impact effects playing at once."),
+	ECVF_Scalability
+);
+
+// Distances from the camera where effects are culled, or switched to their reduced spawn rate LOD
+static TAutoConsoleVariable<float> CVarEffectsCullDistance
+(
+	TEXT("CrazyTank.Effects.CullDistance"),
+	8000.0f,
+	TEXT("Effects farther than this from the camera are not played."),
+	ECVF_Scalability
+);
+
+static TAutoConsoleVariable<float> CVarEffectsReducedDistance
+(
+	TEXT("CrazyTank.Effects.ReducedDistance"),
+	3000.0f,
+	TEXT("Effects farther than this from the camera use their reduced spawn rate LOD (LOD 1)."),
+	ECVF_Scalability
+);
+
+static TAutoConsoleVariable<float> CVarEffectsEvaluationInterval
+(
+	TEXT("CrazyTank.Effects.EvaluationInterval"),
+	0.1f,
+	TEXT("Seconds between two rankings of the looping effects."),
+	ECVF_Default
+);
+
+// Effects this close to the camera count as on screen even when they are behind it (e.g. the player's own dust trail)
+static const float AlwaysRelevantDistance = 500.0f;
+
+// Budget of concurrent systems of every category
+static int32 GetCategoryBudget(EEffectCategory Category)
+{
+	switch (Category)
+	{
+		case EEffectCategory::DustTrail:
+			return CVarEffectsMaxDustTrails.GetValueOnGameThread();
+
+		case EEffectCategory::Destruction:
+			return CVarEffectsMaxDestruction.GetValueOnGameThread();
+
+		case EEffectCategory::Impact:
+			return CVarEffectsMaxImpacts.GetValueOnGameThread();
+
+		default:
+			return 0;
+	}
+}
+
+// Spawn rate LOD for an effect at this distance to the camera, clamped to the LODs its particle system has
+static int32 CalculateLODLevel(const UParticleSystemComponent* Component, float DistanceToView)
+{
+	if (!Component->Template || DistanceToView <= CVarEffectsReducedDistance.GetValueOnGameThread())
+	{
+		return 0;
+	}
+
+	return FMath::Min(1, Component->Template->GetLODLevelCount() - 1);
+}
+
+////////		Puts a looping effect under the budget		////////
+void UEffectBudgetSubsystem::RegisterEffect(UParticleSystemComponent* Component, EEffectCategory Category)
+{
+	if (!Component || FindManagedEffect(Component) != INDEX_NONE)
+	{
+		return;
+	}
+
+	FManagedEffect& Effect = ManagedEffects.AddDefaulted_GetRef();
+	Effect.Component = Component;
+	Effect.Category = Category;
+	Effect.bIsOn = Component->IsActive();
+
+	// Nothing is wanted yet, so if the effect was auto activated it gets turned off in the next evaluation
+	bNeedsEvaluation = true;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Removes a looping effect from the budget		////////
+void UEffectBudgetSubsystem::UnregisterEffect(UParticleSystemComponent* Component)
+{
+	int32 EffectIndex = FindManagedEffect(Component);
+	if (EffectIndex != INDEX_NONE)
+	{
+		ManagedEffects.RemoveAtSwap(EffectIndex);
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Tells whether gameplay wants a looping effect emitting, the budget decides if it actually does		////////
+void UEffectBudgetSubsystem::SetEffectWanted(UParticleSystemComponent* Component, bool bWanted)
+{
+	int32 EffectIndex = FindManagedEffect(Component);
+	if (EffectIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	FManagedEffect& Effect = ManagedEffects[EffectIndex];
+	if (Effect.bIsWanted == bWanted)
+	{
+		return;
+	}
+
+	Effect.bIsWanted = bWanted;
+
+	if (bWanted)
+	{
+		// Turning on has to compete for the budget, that's decided at the end of this frame
+		bNeedsEvaluation = true;
+	}
+	else
+	{
+		// Turning off never needs budget, so it happens right away
+		SetEffectOn(Effect, false, Effect.LODLevel);
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Asks for a slot for a one-shot effect someone else spawns (e.g. an emitter attached to an Actor)		////////
+bool UEffectBudgetSubsystem::TryReserveOneShot(EEffectCategory Category, const FVector& Location, float LifeSeconds)
+{
+	if (!IsRenderingEffects() || CalculateSignificance(Location, CVarEffectsCullDistance.GetValueOnGameThread()) <= 0.0f)
+	{
+		return false;
+	}
+
+	if (CountActiveOneShots(Category) >= GetCategoryBudget(Category))
+	{
+		return false;
+	}
+
+	FOneShotEffect& OneShot = OneShotEffects.AddDefaulted_GetRef();
+	OneShot.Category = Category;
+	OneShot.ExpireTime = GetWorld()->GetTimeSeconds() + LifeSeconds;
+	return true;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Spawns a one-shot effect if it's significant enough and its category has budget left		////////
+UParticleSystemComponent* UEffectBudgetSubsystem::SpawnOneShot(EEffectCategory Category, UParticleSystem* Template, const FVector& Location, const FRotator& Rotation)
+{
+	if (!Template || !TryReserveOneShot(Category, Location))
+	{
+		return nullptr;
+	}
+
+	UParticleSystemComponent* Component = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), Template, Location, Rotation, true);
+	if (!Component)
+	{
+		OneShotEffects.Pop(false);
+		return nullptr;
+	}
+
+	// Far away effects use their reduced spawn rate LOD
+	int32 LODLevel = CalculateLODLevel(Component, bHasView ? FVector::Dist(ViewLocation, Location) : 0.0f);
+	if (LODLevel > 0)
+	{
+		Component->SetLODLevel(LODLevel);
+	}
+
+	// The slot is now tied to the real component, it's freed as soon as the effect finishes
+	OneShotEffects.Last().Component = Component;
+	return Component;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Spawns a one-shot effect through the world's budget, or right away when the world has none		////////
+UParticleSystemComponent* UEffectBudgetSubsystem::SpawnOneShotInWorld(UWorld* World, EEffectCategory Category, UParticleSystem* Template, const FVector& Location, const FRotator& Rotation)
+{
+	if (!World || !Template)
+	{
+		return nullptr;
+	}
+
+	UEffectBudgetSubsystem* EffectBudget = World->GetSubsystem<UEffectBudgetSubsystem>();
+	if (EffectBudget)
+	{
+		return EffectBudget->SpawnOneShot(Category, Template, Location, Rotation);
+	}
+
+	return UGameplayStatics::SpawnEmitterAtLocation(World, Template, Location, Rotation, true);
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Clears the explosion particle DeclaringClass plays on its own, returns the one to play through the budget		////////
+UParticleSystem* UEffectBudgetSubsystem::TakeOverDestructionEffect(AActor* Actor, UClass* DeclaringClass, UParticleSystem* DestructionEffect)
+{
+	if (!Actor || !DeclaringClass)
+	{
+		return DestructionEffect;
+	}
+
+	// The declaring class isn't part of this module, so its particle is found by type and name instead of by member
+	UParticleSystem* UnbudgetedEffect = nullptr;
+	for (TFieldIterator<FObjectProperty> PropertyIt(DeclaringClass, EFieldIteratorFlags::ExcludeSuper); PropertyIt; ++PropertyIt)
+	{
+		FObjectProperty* Property = *PropertyIt;
+		const FString PropertyName = Property->GetName();
+		if (!Property->PropertyClass->IsChildOf(UParticleSystem::StaticClass())
+			|| !(PropertyName.Contains(TEXT("Death")) || PropertyName.Contains(TEXT("Destruction")) || PropertyName.Contains(TEXT("Explosion"))))
+		{
+			continue;
+		}
+
+		UParticleSystem* Effect = Cast<UParticleSystem>(Property->GetObjectPropertyValue_InContainer(Actor));
+		if (Effect)
+		{
+			UnbudgetedEffect = UnbudgetedEffect ? UnbudgetedEffect : Effect;
+			Property->SetObjectPropertyValue_InContainer(Actor, nullptr);
+		}
+	}
+
+	if (!UnbudgetedEffect)
+	{
+		return DestructionEffect;
+	}
+
+	if (!DestructionEffect)
+	{
+		// Blueprints made before the budget only set the parent's particle, it's still played but now through the budget
+		return UnbudgetedEffect;
+	}
+
+	// Both being set used to play two explosions, only the budgeted one is kept (warned once per class)
+	static TSet<FName> WarnedClasses;
+	bool bIsAlreadyWarned = false;
+	WarnedClasses.Add(Actor->GetClass()->GetFName(), &bIsAlreadyWarned);
+	if (!bIsAlreadyWarned)
+	{
+		UE_LOG
+		(
+			LogTemp,
+			Warning,
+			TEXT("%s sets both DestructionEffect and the %s death particle, only DestructionEffect is played (clear the %s one)"),
+			*Actor->GetClass()->GetName(),
+			*DeclaringClass->GetName(),
+			*DeclaringClass->GetName()
+		);
+	}
+
+	return DestructionEffect;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Starts a looping effect, or stops it and lets its particles fade out		////////
+void UEffectBudgetSubsystem::SetEmitting(UParticleSystemComponent* Component, bool bEmitting)
+{
+	// Suppressing the spawning keeps a deactivated system from emitting again when its component is re-registered
+	Component->bSuppressSpawning = !bEmitting;
+
+	if (bEmitting)
+	{
+		Component->Activate(true);
+	}
+	else
+	{
+		Component->Deactivate();
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Re-evaluates the looping effects every few frames		////////
+void UEffectBudgetSubsystem::Tick(float DeltaTime)
+{
+	CRAZYTANK_HITCH_SCOPE("Effects.Tick");
+
+	TimeUntilEvaluation -= DeltaTime;
+	if (!bNeedsEvaluation && TimeUntilEvaluation > 0.0f)
+	{
+		return;
+	}
+
+	TimeUntilEvaluation = CVarEffectsEvaluationInterval.GetValueOnGameThread();
+	bNeedsEvaluation = false;
+
+	UpdateView();
+	EvaluateManagedEffects();
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Reads the local player's camera		////////
+void UEffectBudgetSubsystem::UpdateView()
+{
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (!PlayerController || !PlayerController->PlayerCameraManager)
+	{
+		bHasView = false;
+		return;
+	}
+
+	APlayerCameraManager* CameraManager = PlayerController->PlayerCameraManager;
+	ViewLocation = CameraManager->GetCameraLocation();
+	ViewDirection = CameraManager->GetCameraRotation().Vector();
+
+	// A little margin around the field of view, so effects partially on screen or about to enter it aren't culled
+	ViewCosHalfFOV = FMath::Cos(FMath::DegreesToRadians(FMath::Min(CameraManager->GetFOVAngle() * 0.5f + 15.0f, 180.0f)));
+	bHasView = true;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		How important an effect at this location is to the player: 0 means it should be culled		////////
+float UEffectBudgetSubsystem::CalculateSignificance(const FVector& Location, float CullDistance) const
+{
+	if (!bHasView)
+	{
+		// Without a camera there's nothing to rank against, every effect is equally significant
+		return 1.0f;
+	}
+
+	FVector ToEffect = Location - ViewLocation;
+	float Distance = ToEffect.Size();
+	if (Distance >= CullDistance)
+	{
+		return 0.0f;
+	}
+
+	if (Distance > AlwaysRelevantDistance && FVector::DotProduct(ToEffect / Distance, ViewDirection) < ViewCosHalfFOV)
+	{
+		// Off screen
+		return 0.0f;
+	}
+
+	// Closer effects are more significant
+	return FMath::Max(1.0f - Distance / CullDistance, KINDA_SMALL_NUMBER);
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Ranks the looping effects and turns on only the most significant ones within budget		////////
+void UEffectBudgetSubsystem::EvaluateManagedEffects()
+{
+	// Forget the effects whose components are gone
+	for (int32 EffectIndex = ManagedEffects.Num() - 1; EffectIndex >= 0; EffectIndex--)
+	{
+		if (!ManagedEffects[EffectIndex].Component.IsValid())
+		{
+			ManagedEffects.RemoveAtSwap(EffectIndex);
+		}
+	}
+
+	const float CullDistance = CVarEffectsCullDistance.GetValueOnGameThread();
+
+	// A looping effect competing for its category's budget
+	struct FEffectCandidate
+	{
+		int32 EffectIndex;
+
+		float Significance;
+	};
+
+	// The candidate list only lives during this evaluation, so it's taken from the frame arena
+	FFrameArenaScope ArenaScope;
+	TFrameArray<FEffectCandidate> Candidates;
+	Candidates.Reserve(ManagedEffects.Num());
+
+	for (int32 CategoryIndex = 0; CategoryIndex < (int32)EEffectCategory::Count; CategoryIndex++)
+	{
+		const EEffectCategory Category = (EEffectCategory)CategoryIndex;
+
+		Candidates.Reset();
+		for (int32 EffectIndex = 0; EffectIndex < ManagedEffects.Num(); EffectIndex++)
+		{
+			FManagedEffect& Effect = ManagedEffects[EffectIndex];
+			if (Effect.Category != Category)
+			{
+				continue;
+			}
+
+			float Significance = Effect.bIsWanted ? CalculateSignificance(Effect.Component->GetComponentLocation(), CullDistance) : 0.0f;
+			if (Significance > 0.0f)
+			{
+				Candidates.Add({ EffectIndex, Significance });
+			}
+			else
+			{
+				// Not wanted, off screen or too far away
+				SetEffectOn(Effect, false, Effect.LODLevel);
+			}
+		}
+
+		Candidates.Sort([](const FEffectCandidate& A, const FEffectCandidate& B) { return A.Significance > B.Significance; });
+
+		// Only the most significant effects of the category get to emit
+		const int32 Budget = GetCategoryBudget(Category);
+		for (int32 Rank = 0; Rank < Candidates.Num(); Rank++)
+		{
+			FManagedEffect& Effect = ManagedEffects[Candidates[Rank].EffectIndex];
+			if (Rank < Budget)
+			{
+				float DistanceToView = bHasView ? FVector::Dist(ViewLocation, Effect.Component->GetComponentLocation()) : 0.0f;
+				SetEffectOn(Effect, true, CalculateLODLevel(Effect.Component.Get(), DistanceToView));
+			}
+			else
+			{
+				SetEffectOn(Effect, false, Effect.LODLevel);
+			}
+		}
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Turns a looping effect on (with the given spawn rate LOD) or off		////////
+void UEffectBudgetSubsystem::SetEffectOn(FManagedEffect& Effect, bool bOn, int32 LODLevel)
+{
+	UParticleSystemComponent* Component = Effect.Component.Get();
+	if (!Component)
+	{
+		return;
+	}
+
+	if (!bOn)
+	{
+		if (Effect.bIsOn)
+		{
+			// Stop spawning but let the particles already emitted fade out
+			SetEmitting(Component, false);
+			Effect.bIsOn = false;
+		}
+		return;
+	}
+
+	if (!Effect.bIsOn)
+	{
+		SetEmitting(Component, true);
+		Effect.bIsOn = true;
+	}
+
+	if (Effect.LODLevel != LODLevel)
+	{
+		// Particle systems meant to be budgeted use the "Direct Set" LOD method, so this LOD sticks
+		Component->SetLODLevel(LODLevel);
+		Effect.LODLevel = LODLevel;
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Counts the one-shot effects of a category that are still playing		////////
+int32 UEffectBudgetSubsystem::CountActiveOneShots(EEffectCategory Category)
+{
+	const float Now = GetWorld()->GetTimeSeconds();
+	int32 ActiveCount = 0;
+
+	for (int32 OneShotIndex = OneShotEffects.Num() - 1; OneShotIndex >= 0; OneShotIndex--)
+	{
+		const FOneShotEffect& OneShot = OneShotEffects[OneShotIndex];
+
+		// Effects we spawned are over when their component is, the reserved ones when their expected life is over
+		bool bIsOver = OneShot.Component.IsValid() ? !OneShot.Component->IsActive() : Now >= OneShot.ExpireTime;
+		if (bIsOver)
+		{
+			OneShotEffects.RemoveAtSwap(OneShotIndex, 1, false);
+		}
+		else if (OneShot.Category == Category)
+		{
+			ActiveCount++;
+		}
+	}
+
+	return ActiveCount;
+}
+////////////////////////////////////////////////////////////////////////
+
+int32 UEffectBudgetSubsystem::FindManagedEffect(const UParticleSystemComponent* Component) const
+{
+	return ManagedEffects.IndexOfByPredicate([Component](const FManagedEffect& Effect) { return Effect.Component.Get() == Component; });
+}
+
+bool UEffectBudgetSubsystem::IsRenderingEffects() const
+{
+	UWorld* World = GetWorld();
+	return World && World->GetNetMode() != NM_DedicatedServer;
+}
+
+////////		Called when the world is torn down		////////
+void UEffectBudgetSubsystem::Deinitialize()
+{
+	ManagedEffects.Empty();
+	OneShotEffects.Empty();
+
+	Super::Deinitialize();
+}
+////////////////////////////////////////////////////////////////////////
+
+bool UEffectBudgetSubsystem::HasWorkToTick() const
+{
+	return IsRenderingEffects();
+}
+
+TStatId UEffectBudgetSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEffectBudgetSubsystem, STATGROUP_Tickables);
+}
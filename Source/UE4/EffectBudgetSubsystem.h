@@ -0,0 +1,159 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CrazyTankTickableWorldSubsystem.h"
+#include "EffectBudgetSubsystem.generated.h"
+
+/*
+
+	Engine classes
+
+*/
+
+class AActor;
+class UParticleSystem;
+class UParticleSystemComponent;
+
+// Kinds of particle effects, every kind has its own limit of concurrent systems
+UENUM(BlueprintType)
+enum class EEffectCategory : uint8
+{
+	DustTrail,		// Looping trails left by moving Tanks
+	Destruction,	// One-shot explosions of destroyed Pawns
+	Impact,			// One-shot hits of projectiles
+	Count UMETA(Hidden)
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This class keeps the amount of particle systems running at once under a budget: it ranks the effects by their
+// distance to the camera and whether they are on screen, caps the concurrent systems of every category,
+// lowers the spawn rate (LOD) of the less significant ones and culls the ones that are off-screen or far away
+//
+//////////////////////////////////////////////////////////////////////////////
+UCLASS()
+class CRAZYTANK_API UEffectBudgetSubsystem : public UCrazyTankTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	// A looping effect whose activation is decided by the budget
+	struct FManagedEffect
+	{
+		TWeakObjectPtr<UParticleSystemComponent> Component;
+
+		EEffectCategory Category = EEffectCategory::DustTrail;
+
+		bool bIsWanted = false; // Gameplay wants it emitting (e.g. the Tank is moving on ground)
+
+		bool bIsOn = false; // It's currently emitting
+
+		int32 LODLevel = 0;
+	};
+
+	// A one-shot effect counted against its category's budget until it's expected to be over
+	struct FOneShotEffect
+	{
+		TWeakObjectPtr<UParticleSystemComponent> Component; // Not set when the effect was spawned by someone else
+
+		EEffectCategory Category = EEffectCategory::Impact;
+
+		float ExpireTime = 0.0f;
+	};
+
+	TArray<FManagedEffect> ManagedEffects;
+
+	TArray<FOneShotEffect> OneShotEffects;
+
+	float TimeUntilEvaluation = 0.0f;
+
+	bool bNeedsEvaluation = false; // An effect was registered or became wanted since the last evaluation
+
+	// Where the local player is looking from, updated before every evaluation
+	FVector ViewLocation = FVector::ZeroVector;
+
+	FVector ViewDirection = FVector::ForwardVector;
+
+	float ViewCosHalfFOV = 0.0f;
+
+	bool bHasView = false;
+
+	/*
+		METHODS
+	*/
+
+	void UpdateView(); // Reads the local player's camera
+
+	// How important an effect at this location is to the player: 0 means it should be culled
+	float CalculateSignificance(const FVector& Location, float CullDistance) const;
+
+	void EvaluateManagedEffects(); // Ranks the looping effects and turns on only the most significant ones within budget
+
+	void SetEffectOn(FManagedEffect& Effect, bool bOn, int32 LODLevel);
+
+	int32 CountActiveOneShots(EEffectCategory Category); // Also forgets the one-shot effects that are over
+
+	int32 FindManagedEffect(const UParticleSystemComponent* Component) const;
+
+	bool IsRenderingEffects() const; // Dedicated servers never show any effect
+
+public:
+
+	/*
+		METHODS
+	*/
+
+	void RegisterEffect(UParticleSystemComponent* Component, EEffectCategory Category); // Puts a looping effect under the budget
+
+	void UnregisterEffect(UParticleSystemComponent* Component);
+
+	// Tells whether gameplay wants a looping effect emitting, the budget decides if it actually does
+	void SetEffectWanted(UParticleSystemComponent* Component, bool bWanted);
+
+	// Asks for a slot for a one-shot effect someone else spawns (e.g. an emitter attached to an Actor)
+	bool TryReserveOneShot(EEffectCategory Category, const FVector& Location, float LifeSeconds = 2.0f);
+
+	// Spawns a one-shot effect if it's significant enough and its category has budget left
+	UParticleSystemComponent* SpawnOneShot(EEffectCategory Category, UParticleSystem* Template, const FVector& Location, const FRotator& Rotation);
+
+	// Spawns a one-shot effect through the world's budget, or right away when the world has none
+	static UParticleSystemComponent* SpawnOneShotInWorld(UWorld* World, EEffectCategory Category, UParticleSystem* Template, const FVector& Location, const FRotator& Rotation);
+
+	// Clears the explosion particle DeclaringClass plays on its own when Actor is destroyed (e.g. the "PawnBase" death particle),
+	static UParticleSystem* TakeOverDestructionEffect(AActor* Actor, UClass* DeclaringClass, UParticleSystem* DestructionEffect); // Returns the one to play through the budget
+
+	// Starts a looping effect, or stops it and lets its particles fade out (also used on effects that aren't budgeted)
+	static void SetEmitting(UParticleSystemComponent* Component, bool bEmitting);
+
+	virtual void Deinitialize() override; // Called when the world is torn down
+
+	/*
+		FTickableGameObject interface
+	*/
+
+	virtual void Tick(float DeltaTime) override; // Re-evaluates the looping effects every few frames
+
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/*
+		METHODS
+	*/
+
+	virtual bool HasWorkToTick() const override; // Only where effects are rendered (not on dedicated servers)
+
+};
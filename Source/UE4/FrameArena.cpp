@@ -0,0 +1,310 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "FrameArena.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTLS.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/ScopeLock.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+// Size of every block the arenas take from the general heap (bigger allocations get a block of their own size)
+static const SIZE_T FrameArenaBlockSize = 256 * 1024;
+
+// Every thread's arena, so their stats can be logged and closed at the end of the frame
+static FCriticalSection& GetArenasLock()
+{
+	static FCriticalSection ArenasLock;
+	return ArenasLock;
+}
+
+static TArray<FFrameArena*>& GetArenas()
+{
+	static TArray<FFrameArena*> Arenas;
+	return Arenas;
+}
+
+static FAutoConsoleCommand FrameArenaStatsCommand
+(
+	TEXT("CrazyTank.FrameArena.Stats"),
+	TEXT("Logs the per-frame high-water mark of every thread's frame arena."),
+	FConsoleCommandDelegate::CreateStatic(&FFrameArena::LogStats)
+);
+
+/*
+
+	FFrameArena
+
+*/
+
+////////		The arena of the calling thread (created the first time a thread asks for it)		////////
+FFrameArena& FFrameArena::Get()
+{
+	static thread_local FFrameArena ThreadArena;
+
+	// The game thread's arena is reset at the end of every frame, the other threads rely on FFrameArenaScope.
+	// Only the game thread reads or writes the flag, the thread check must come first so workers never touch it
+	static bool bIsEndFrameBound = false;
+	if (IsInGameThread() && !bIsEndFrameBound)
+	{
+		FCoreDelegates::OnEndFrame.AddStatic(&FFrameArena::OnEndFrame);
+		bIsEndFrameBound = true;
+	}
+
+	return ThreadArena;
+}
+////////////////////////////////////////////////////////////////////////
+
+FFrameArena::FFrameArena()
+	: FrameHighWater(0)
+	, LastFrameHighWater(0)
+	, PeakHighWater(0)
+	, HeapBlockAllocations(0)
+{
+	ThreadId = FPlatformTLS::GetCurrentThreadId();
+
+	FScopeLock Lock(&GetArenasLock());
+	GetArenas().Add(this);
+}
+
+FFrameArena::~FFrameArena()
+{
+	{
+		FScopeLock Lock(&GetArenasLock());
+		GetArenas().RemoveSwap(this);
+	}
+
+	for (FBlock& Block : Blocks)
+	{
+		FMemory::Free(Block.Memory);
+	}
+}
+
+////////		Memory valid until the end of the frame (or of the enclosing scope)		////////
+void* FFrameArena::Allocate(SIZE_T Size, uint32 Alignment)
+{
+	Alignment = FMath::Max<uint32>(Alignment, 8);
+
+	for (;;)
+	{
+		if (CurrentBlock < Blocks.Num())
+		{
+			FBlock& Block = Blocks[CurrentBlock];
+			uint8* AlignedMemory = Align(Block.Memory + Offset, Alignment);
+			SIZE_T AlignedOffset = AlignedMemory - Block.Memory;
+
+			if (AlignedOffset + Size <= Block.Size)
+			{
+				UsedBytes += AlignedOffset + Size - Offset;
+				Offset = AlignedOffset + Size;
+				LastAllocation = AlignedMemory;
+				UpdateHighWater();
+				return AlignedMemory;
+			}
+
+			// Doesn't fit in the current block, the next one (kept from a previous frame) is used if it's big enough
+			if (CurrentBlock + 1 < Blocks.Num() && Blocks[CurrentBlock + 1].Size >= Size + Alignment)
+			{
+				CurrentBlock++;
+				Offset = 0;
+				continue;
+			}
+		}
+
+		// Warming up: take a new block from the general heap, it'll be kept for every following frame
+		FBlock NewBlock;
+		NewBlock.Size = FMath::Max(FrameArenaBlockSize, Size + Alignment);
+		NewBlock.Memory = (uint8*)FMemory::Malloc(NewBlock.Size, 16);
+		HeapBlockAllocations++;
+
+		CurrentBlock = Blocks.Num() == 0 ? 0 : CurrentBlock + 1;
+		Blocks.Insert(NewBlock, CurrentBlock);
+		Offset = 0;
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Grows or shrinks the last allocation where it is		////////
+bool FFrameArena::TryResizeInPlace(void* Allocation, SIZE_T OldSize, SIZE_T NewSize)
+{
+	if (Allocation == nullptr || Allocation != LastAllocation || !Blocks.IsValidIndex(CurrentBlock))
+	{
+		return false;
+	}
+
+	FBlock& Block = Blocks[CurrentBlock];
+	SIZE_T AllocationOffset = (uint8*)Allocation - Block.Memory;
+	if (AllocationOffset + NewSize > Block.Size)
+	{
+		return false;
+	}
+
+	UsedBytes = UsedBytes - OldSize + NewSize;
+	Offset = AllocationOffset + NewSize;
+	UpdateHighWater();
+	return true;
+}
+////////////////////////////////////////////////////////////////////////
+
+FFrameArena::FMark FFrameArena::GetMark() const
+{
+	FMark Mark;
+	Mark.BlockIndex = CurrentBlock;
+	Mark.Offset = Offset;
+	Mark.UsedBytes = UsedBytes;
+	return Mark;
+}
+
+////////		Gives back everything allocated after the mark		////////
+void FFrameArena::PopToMark(const FMark& Mark)
+{
+	// Blocks inserted after the mark was taken only ever go after its block, so the mark stays valid
+	CurrentBlock = Mark.BlockIndex;
+	Offset = Mark.Offset;
+	UsedBytes = Mark.UsedBytes;
+	LastAllocation = nullptr;
+}
+////////////////////////////////////////////////////////////////////////
+
+uint32 FFrameArena::GetGeneration() const
+{
+	return Generation;
+}
+
+////////		Gives back everything (end of frame)		////////
+void FFrameArena::Reset()
+{
+	CurrentBlock = 0;
+	Offset = 0;
+	UsedBytes = 0;
+	LastAllocation = nullptr;
+	Generation++;
+}
+////////////////////////////////////////////////////////////////////////
+
+void FFrameArena::UpdateHighWater()
+{
+	if (UsedBytes > FrameHighWater.Load(EMemoryOrder::Relaxed))
+	{
+		FrameHighWater.Store(UsedBytes, EMemoryOrder::Relaxed);
+	}
+}
+
+////////		Closes the frame's high-water mark		////////
+void FFrameArena::HarvestFrameStats()
+{
+	// Racing with a worker thread allocating right now only makes this frame's stat a little off, never unsafe
+	uint64 HighWater = FrameHighWater.Exchange(0);
+	LastFrameHighWater.Store(HighWater, EMemoryOrder::Relaxed);
+	if (HighWater > PeakHighWater.Load(EMemoryOrder::Relaxed))
+	{
+		PeakHighWater.Store(HighWater, EMemoryOrder::Relaxed);
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Resets the game thread's arena and closes every arena's frame stats		////////
+void FFrameArena::OnEndFrame()
+{
+	FFrameArena& GameThreadArena = Get();
+	GameThreadArena.Reset();
+
+	uint64 TotalHighWater = 0;
+	{
+		FScopeLock Lock(&GetArenasLock());
+		for (FFrameArena* Arena : GetArenas())
+		{
+			Arena->HarvestFrameStats();
+			TotalHighWater += Arena->LastFrameHighWater.Load(EMemoryOrder::Relaxed);
+		}
+	}
+
+	CSV_CUSTOM_STAT_GLOBAL(FrameArenaHighWaterKB, (float)(TotalHighWater / 1024.0), ECsvCustomStatOp::Set);
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Logs the high-water marks of every thread's arena		////////
+void FFrameArena::LogStats()
+{
+	FScopeLock Lock(&GetArenasLock());
+
+	for (FFrameArena* Arena : GetArenas())
+	{
+		UE_LOG
+		(
+			LogTemp,
+			Display,
+			TEXT("Frame arena (thread %u): last frame %llu KB, peak %llu KB, %llu heap blocks"),
+			Arena->ThreadId,
+			Arena->LastFrameHighWater.Load(EMemoryOrder::Relaxed) / 1024,
+			Arena->PeakHighWater.Load(EMemoryOrder::Relaxed) / 1024,
+			Arena->HeapBlockAllocations.Load(EMemoryOrder::Relaxed)
+		);
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+/*
+
+	FFrameArenaAllocator
+
+*/
+
+void FFrameArenaAllocator::ForAnyElementType::ResizeAllocation(SizeType PreviousNumElements, SizeType NumElements, SIZE_T NumBytesPerElement)
+{
+	ResizeAllocation(PreviousNumElements, NumElements, NumBytesPerElement, 16);
+}
+
+////////		Moves the container's elements to a bigger (or smaller) piece of the calling thread's arena		////////
+void FFrameArenaAllocator::ForAnyElementType::ResizeAllocation(SizeType PreviousNumElements, SizeType NumElements, SIZE_T NumBytesPerElement, uint32 AlignmentOfElement)
+{
+	if (NumElements <= 0)
+	{
+		// The memory goes back to the arena when the frame (or the scope) ends
+		Data = nullptr;
+		AllocatedBytes = 0;
+		Owner = nullptr;
+		return;
+	}
+
+	FFrameArena& Arena = FFrameArena::Get();
+	checkf
+	(
+		!Data || Owner != &Arena || Generation == Arena.GetGeneration(),
+		TEXT("A frame arena container is being used after the frame it was allocated in")
+	);
+
+	SIZE_T NewBytes = (SIZE_T)NumElements * NumBytesPerElement;
+	if (Data && Owner == &Arena)
+	{
+		if (Arena.TryResizeInPlace(Data, AllocatedBytes, NewBytes))
+		{
+			AllocatedBytes = NewBytes;
+			return;
+		}
+
+		if (NewBytes <= AllocatedBytes)
+		{
+			// Shrinking somewhere else would only waste more of the arena, the current memory is big enough
+			return;
+		}
+	}
+
+	void* NewData = Arena.Allocate(NewBytes, AlignmentOfElement);
+	if (Data && PreviousNumElements > 0)
+	{
+		// UE containers' elements are always bitwise relocatable, the old copy is simply left behind in the arena
+		FMemory::Memcpy(NewData, Data, FMath::Min((SIZE_T)PreviousNumElements * NumBytesPerElement, NewBytes));
+	}
+
+	Data = (FScriptContainerElement*)NewData;
+	AllocatedBytes = NewBytes;
+	Owner = &Arena;
+	Generation = Arena.GetGeneration();
+}
+////////////////////////////////////////////////////////////////////////
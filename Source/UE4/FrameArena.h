@@ -0,0 +1,279 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/Atomic.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This class is a linear (bump) allocator owned by a single thread: allocating only moves an offset forward,
+// and all of its memory is given back at once when the frame ends (game thread) or when a FFrameArenaScope ends.
+// Its blocks are kept between frames, so once it has warmed up it never touches the general heap again
+//
+//////////////////////////////////////////////////////////////////////////////
+class CRAZYTANK_API FFrameArena
+{
+public:
+
+	/*
+		VARIABLES
+	*/
+
+	// A position in the arena that can be rewound to, every allocation made after it is given back at once
+	struct FMark
+	{
+		int32 BlockIndex = 0;
+
+		SIZE_T Offset = 0;
+
+		SIZE_T UsedBytes = 0;
+	};
+
+	/*
+		METHODS
+	*/
+
+	static FFrameArena& Get(); // The arena of the calling thread (created the first time a thread asks for it)
+
+	void* Allocate(SIZE_T Size, uint32 Alignment); // Memory valid until the end of the frame (or of the enclosing scope)
+
+	// Grows or shrinks the last allocation where it is, returns false if it isn't the last one or there's no room
+	bool TryResizeInPlace(void* Allocation, SIZE_T OldSize, SIZE_T NewSize);
+
+	FMark GetMark() const;
+
+	void PopToMark(const FMark& Mark); // Gives back everything allocated after the mark
+
+	uint32 GetGeneration() const; // Changes every time the arena is reset, to catch containers that outlived their frame
+
+	static void LogStats(); // Logs the high-water marks of every thread's arena
+
+	~FFrameArena();
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	struct FBlock
+	{
+		uint8* Memory = nullptr;
+
+		SIZE_T Size = 0;
+	};
+
+	TArray<FBlock> Blocks;
+
+	int32 CurrentBlock = 0;
+
+	SIZE_T Offset = 0; // Next free byte in the current block
+
+	SIZE_T UsedBytes = 0; // Bytes handed out since the last reset, across every block
+
+	void* LastAllocation = nullptr; // Only the last allocation can be resized in place
+
+	uint32 Generation = 0;
+
+	uint32 ThreadId = 0;
+
+	// Stats, read by other threads when logging
+	TAtomic<uint64> FrameHighWater;
+
+	TAtomic<uint64> LastFrameHighWater;
+
+	TAtomic<uint64> PeakHighWater;
+
+	TAtomic<uint64> HeapBlockAllocations; // Blocks taken from the general heap, it stops growing once the arena has warmed up
+
+	/*
+		METHODS
+	*/
+
+	FFrameArena();
+
+	void Reset(); // Gives back everything (end of frame)
+
+	void UpdateHighWater();
+
+	void HarvestFrameStats(); // Closes the frame's high-water mark
+
+	static void OnEndFrame(); // Resets the game thread's arena and closes every arena's frame stats
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Everything allocated from the calling thread's arena while this scope is alive is given back when it ends,
+// worker threads (e.g. ParallelFor bodies) must open one because their arenas aren't reset at the end of the frame
+//
+//////////////////////////////////////////////////////////////////////////////
+class FFrameArenaScope
+{
+public:
+
+	FFrameArenaScope()
+		: Arena(FFrameArena::Get())
+		, Mark(Arena.GetMark())
+	{
+	}
+
+	~FFrameArenaScope()
+	{
+		Arena.PopToMark(Mark);
+	}
+
+	FFrameArenaScope(const FFrameArenaScope&) = delete;
+
+	FFrameArenaScope& operator=(const FFrameArenaScope&) = delete;
+
+private:
+
+	FFrameArena& Arena;
+
+	FFrameArena::FMark Mark;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Container allocator taking its memory from the calling thread's frame arena. Containers using it must not
+// outlive the frame (or the FFrameArenaScope) they were filled in: their memory is reused afterwards
+//
+//////////////////////////////////////////////////////////////////////////////
+class CRAZYTANK_API FFrameArenaAllocator
+{
+public:
+
+	using SizeType = int32;
+
+	enum { NeedsElementType = false };
+
+	enum { RequireRangeCheck = true };
+
+	class CRAZYTANK_API ForAnyElementType
+	{
+	public:
+
+		ForAnyElementType() = default;
+
+		ForAnyElementType(const ForAnyElementType&) = delete;
+
+		ForAnyElementType& operator=(const ForAnyElementType&) = delete;
+
+		FORCEINLINE void MoveToEmpty(ForAnyElementType& Other)
+		{
+			checkSlow(this != &Other);
+
+			Data = Other.Data;
+			AllocatedBytes = Other.AllocatedBytes;
+			Owner = Other.Owner;
+			Generation = Other.Generation;
+
+			Other.Data = nullptr;
+			Other.AllocatedBytes = 0;
+			Other.Owner = nullptr;
+		}
+
+		FORCEINLINE FScriptContainerElement* GetAllocation() const
+		{
+			return Data;
+		}
+
+		void ResizeAllocation(SizeType PreviousNumElements, SizeType NumElements, SIZE_T NumBytesPerElement);
+
+		void ResizeAllocation(SizeType PreviousNumElements, SizeType NumElements, SIZE_T NumBytesPerElement, uint32 AlignmentOfElement);
+
+		FORCEINLINE SizeType CalculateSlackReserve(SizeType NumElements, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackReserve(NumElements, NumBytesPerElement, false);
+		}
+
+		FORCEINLINE SizeType CalculateSlackReserve(SizeType NumElements, SIZE_T NumBytesPerElement, uint32 AlignmentOfElement) const
+		{
+			return DefaultCalculateSlackReserve(NumElements, NumBytesPerElement, false, AlignmentOfElement);
+		}
+
+		// Shrinking never gives memory back to an arena, so it's never worth it
+		FORCEINLINE SizeType CalculateSlackShrink(SizeType NumElements, SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return NumAllocatedElements;
+		}
+
+		FORCEINLINE SizeType CalculateSlackShrink(SizeType NumElements, SizeType NumAllocatedElements, SIZE_T NumBytesPerElement, uint32 AlignmentOfElement) const
+		{
+			return NumAllocatedElements;
+		}
+
+		FORCEINLINE SizeType CalculateSlackGrow(SizeType NumElements, SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return DefaultCalculateSlackGrow(NumElements, NumAllocatedElements, NumBytesPerElement, false);
+		}
+
+		FORCEINLINE SizeType CalculateSlackGrow(SizeType NumElements, SizeType NumAllocatedElements, SIZE_T NumBytesPerElement, uint32 AlignmentOfElement) const
+		{
+			return DefaultCalculateSlackGrow(NumElements, NumAllocatedElements, NumBytesPerElement, false, AlignmentOfElement);
+		}
+
+		FORCEINLINE SIZE_T GetAllocatedSize(SizeType NumAllocatedElements, SIZE_T NumBytesPerElement) const
+		{
+			return NumAllocatedElements * NumBytesPerElement;
+		}
+
+		FORCEINLINE bool HasAllocation() const
+		{
+			return Data != nullptr;
+		}
+
+		FORCEINLINE SizeType GetInitialCapacity() const
+		{
+			return 0;
+		}
+
+	private:
+
+		FScriptContainerElement* Data = nullptr;
+
+		SIZE_T AllocatedBytes = 0;
+
+		FFrameArena* Owner = nullptr; // Arena of the thread that made the allocation
+
+		uint32 Generation = 0; // Owner's generation when the allocation was made
+	};
+
+	template<typename ElementType>
+	class ForElementType : public ForAnyElementType
+	{
+	public:
+
+		ForElementType() = default;
+
+		FORCEINLINE ElementType* GetAllocation() const
+		{
+			return (ElementType*)ForAnyElementType::GetAllocation();
+		}
+	};
+};
+
+template<>
+struct TAllocatorTraits<FFrameArenaAllocator> : TAllocatorTraitsBase<FFrameArenaAllocator>
+{
+	enum { SupportsMove = true };
+
+	enum { IsZeroConstruct = true };
+};
+
+// Set allocator whose elements, bit array and hash all live in the frame arena
+using FFrameArenaSetAllocator = TSetAllocator<TSparseArrayAllocator<FFrameArenaAllocator, FFrameArenaAllocator>, FFrameArenaAllocator>;
+
+// Per-frame temporary containers (candidate lists, hit results, spawn parameters...) that never touch the general heap
+template<typename ElementType>
+using TFrameArray = TArray<ElementType, FFrameArenaAllocator>;
+
+template<typename ElementType>
+using TFrameSet = TSet<ElementType, DefaultKeyFuncs<ElementType>, FFrameArenaSetAllocator>;
@@ -0,0 +1,70 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// One timed gameplay scope inside a frame
+struct FHitchEvent
+{
+	const TCHAR* Name; // Always a string literal (see CRAZYTANK_HITCH_SCOPE), so it's never copied
+
+	uint64 StartCycles;
+
+	uint64 EndCycles;
+
+	int32 Depth; // 0 for scopes that aren't inside another scope
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// The timeline of the frame being recorded by the Hitch Capture Subsystem (game thread only,
+// the frames are opened and closed by UHitchCaptureSubsystem)
+//
+//////////////////////////////////////////////////////////////////////////////
+struct CRAZYTANK_API FHitchCapture
+{
+	static bool bIsCapturing; // When false, the scopes below don't even read the clock
+
+	static TArray<FHitchEvent>* CurrentEvents; // Events of the frame being recorded
+
+	static int32 CurrentDepth;
+
+	static int32 MaxEventsPerFrame; // Scopes past this amount are dropped, so a runaway frame can't grow the buffers forever
+
+	static int32 DroppedEvents; // Scopes dropped in the frame being recorded
+
+	static int32 BeginEvent(const TCHAR* Name); // Returns the event's index, INDEX_NONE when it was dropped
+
+	static void EndEvent(int32 EventIndex);
+};
+
+// Times a scope into the frame's timeline, while the Hitch Capture Subsystem is recording
+struct FHitchScope
+{
+	int32 EventIndex = INDEX_NONE;
+
+	explicit FHitchScope(const TCHAR* Name)
+	{
+		if (FHitchCapture::bIsCapturing && IsInGameThread())
+		{
+			EventIndex = FHitchCapture::BeginEvent(Name);
+		}
+	}
+
+	~FHitchScope()
+	{
+		if (EventIndex != INDEX_NONE)
+		{
+			FHitchCapture::EndEvent(EventIndex);
+		}
+	}
+};
+
+#define CRAZYTANK_HITCH_SCOPE(Name) FHitchScope PREPROCESSOR_JOIN(HitchScope, __LINE__)(TEXT(Name))
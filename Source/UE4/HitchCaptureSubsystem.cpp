@@ -0,0 +1,363 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "HitchCaptureSubsystem.h"
+#include "Async/Async.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "CrazyTank/Actors/PickUpBase.h"
+#include "PawnTank.h"
+#include "PawnTurret.h"
+#include "BallisticProjectileSubsystem.h"
+#include "DestructionSubsystem.h"
+#include "PickUpSubsystem.h"
+
+static TAutoConsoleVariable<int32> CVarHitchEnabled
+(
+	TEXT("CrazyTank.Hitch.Enabled"),
+	1,
+	TEXT("Records the gameplay timeline of every frame and saves the frames around a hitch to Saved/Hitches/."),
+	ECVF_Default
+);
+
+static TAutoConsoleVariable<float> CVarHitchThresholdMs
+(
+	TEXT("CrazyTank.Hitch.ThresholdMs"),
+	50.0f,
+	TEXT("A frame taking longer than this (in milliseconds) is saved as a hitch."),
+	ECVF_Default
+);
+
+static TAutoConsoleVariable<int32> CVarHitchHistoryFrames
+(
+	TEXT("CrazyTank.Hitch.HistoryFrames"),
+	30,
+	TEXT("Frames kept in the ring buffer and saved with every hitch (the hitch frame included)."),
+	ECVF_Default
+);
+
+static TAutoConsoleVariable<float> CVarHitchCooldownSeconds
+(
+	TEXT("CrazyTank.Hitch.CooldownSeconds"),
+	5.0f,
+	TEXT("Hitches closer than this to the last saved one aren't saved, so a bad stretch doesn't write hundreds of files."),
+	ECVF_Default
+);
+
+/*
+
+	FHitchCapture
+
+*/
+
+bool FHitchCapture::bIsCapturing = false;
+
+TArray<FHitchEvent>* FHitchCapture::CurrentEvents = nullptr;
+
+int32 FHitchCapture::CurrentDepth = 0;
+
+int32 FHitchCapture::MaxEventsPerFrame = 8192;
+
+int32 FHitchCapture::DroppedEvents = 0;
+
+int32 FHitchCapture::BeginEvent(const TCHAR* Name)
+{
+	if (!CurrentEvents || CurrentEvents->Num() >= MaxEventsPerFrame)
+	{
+		DroppedEvents++;
+		return INDEX_NONE;
+	}
+
+	FHitchEvent Event;
+	Event.Name = Name;
+	Event.StartCycles = FPlatformTime::Cycles64();
+	Event.EndCycles = Event.StartCycles;
+	Event.Depth = CurrentDepth++;
+	return CurrentEvents->Add(Event);
+}
+
+void FHitchCapture::EndEvent(int32 EventIndex)
+{
+	CurrentDepth--;
+
+	// The frame may have been closed while the scope was open, its events belong to the next frame then
+	if (CurrentEvents && CurrentEvents->IsValidIndex(EventIndex))
+	{
+		(*CurrentEvents)[EventIndex].EndCycles = FPlatformTime::Cycles64();
+	}
+}
+
+/*
+
+	UHitchCaptureSubsystem
+
+*/
+
+UHitchCaptureSubsystem* UHitchCaptureSubsystem::ActiveCapture = nullptr;
+
+////////		Starts recording in game worlds		////////
+void UHitchCaptureSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UWorld* World = GetWorld();
+	if (!World || !World->IsGameWorld() || ActiveCapture)
+	{
+		return;
+	}
+
+	// The frame boundaries come from the engine loop, so the time spent outside of gameplay code (GC, physics,
+	// waiting for the render thread...) still counts towards the hitch, it just isn't covered by any scope
+	ActiveCapture = this;
+	BeginFrameHandle = FCoreDelegates::OnBeginFrame.AddUObject(this, &UHitchCaptureSubsystem::OnBeginFrame);
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &UHitchCaptureSubsystem::OnEndFrame);
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Called when the world is torn down		////////
+void UHitchCaptureSubsystem::Deinitialize()
+{
+	if (ActiveCapture == this)
+	{
+		FCoreDelegates::OnBeginFrame.Remove(BeginFrameHandle);
+		FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+
+		FHitchCapture::bIsCapturing = false;
+		FHitchCapture::CurrentEvents = nullptr;
+		ActiveCapture = nullptr;
+	}
+
+	Frames.Empty();
+
+	Super::Deinitialize();
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Starts recording a new frame in the ring buffer		////////
+void UHitchCaptureSubsystem::OnBeginFrame()
+{
+	if (CVarHitchEnabled.GetValueOnGameThread() == 0)
+	{
+		FHitchCapture::bIsCapturing = false;
+		FHitchCapture::CurrentEvents = nullptr;
+		bIsFrameOpen = false;
+		return;
+	}
+
+	int32 HistoryFrames = FMath::Clamp(CVarHitchHistoryFrames.GetValueOnGameThread(), 1, 600);
+	if (Frames.Num() != HistoryFrames)
+	{
+		// The order of the old frames is lost when resizing, so the history starts over
+		Frames.SetNum(HistoryFrames);
+		CurrentFrame = 0;
+		RecordedFrames = 0;
+	}
+
+	FHitchFrame& Frame = Frames[CurrentFrame];
+	Frame.FrameNumber = GFrameCounter;
+	Frame.Events.Reset();
+	Frame.DroppedEvents = 0;
+	Frame.StartCycles = FPlatformTime::Cycles64();
+
+	FHitchCapture::CurrentEvents = &Frame.Events;
+	FHitchCapture::CurrentDepth = 0;
+	FHitchCapture::DroppedEvents = 0;
+	FHitchCapture::bIsCapturing = true;
+	bIsFrameOpen = true;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Closes the frame and saves a capture if it went over the threshold		////////
+void UHitchCaptureSubsystem::OnEndFrame()
+{
+	if (!bIsFrameOpen)
+	{
+		// Started recording in the middle of a frame, or recording is disabled
+		return;
+	}
+
+	FHitchFrame& Frame = Frames[CurrentFrame];
+	Frame.EndCycles = FPlatformTime::Cycles64();
+	Frame.DroppedEvents = FHitchCapture::DroppedEvents;
+
+	FHitchCapture::bIsCapturing = false;
+	FHitchCapture::CurrentEvents = nullptr;
+	bIsFrameOpen = false;
+
+	int32 HitchFrame = CurrentFrame;
+	CurrentFrame = (CurrentFrame + 1) % Frames.Num();
+	RecordedFrames = FMath::Min(RecordedFrames + 1, Frames.Num());
+
+	double FrameMs = FPlatformTime::ToMilliseconds64(Frame.EndCycles - Frame.StartCycles);
+	if (FrameMs <= CVarHitchThresholdMs.GetValueOnGameThread())
+	{
+		return;
+	}
+
+	double Now = FPlatformTime::Seconds();
+	if (Now - LastCaptureTime < CVarHitchCooldownSeconds.GetValueOnGameThread())
+	{
+		return;
+	}
+	LastCaptureTime = Now;
+
+	SaveCapture(HitchFrame);
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Writes the hitch frame and the ones before it to Saved/Hitches/		////////
+void UHitchCaptureSubsystem::SaveCapture(int32 HitchFrame)
+{
+	UWorld* World = GetWorld();
+	const FHitchFrame& Frame = Frames[HitchFrame];
+	double FrameMs = FPlatformTime::ToMilliseconds64(Frame.EndCycles - Frame.StartCycles);
+
+	// The trigger is the top level scope that took the longest, the time outside of every scope is reported apart
+	const FHitchEvent* Trigger = nullptr;
+	double ScopedMs = 0.0;
+	for (const FHitchEvent& Event : Frame.Events)
+	{
+		if (Event.Depth != 0)
+		{
+			continue;
+		}
+
+		ScopedMs += FPlatformTime::ToMilliseconds64(Event.EndCycles - Event.StartCycles);
+		if (!Trigger || Event.EndCycles - Event.StartCycles > Trigger->EndCycles - Trigger->StartCycles)
+		{
+			Trigger = &Event;
+		}
+	}
+
+	// Counted only when a hitch is saved, never while recording
+	int32 ActorCount = 0;
+	for (ULevel* Level : World->GetLevels())
+	{
+		ActorCount += Level ? Level->Actors.Num() : 0;
+	}
+
+	int32 TankCount = 0;
+	for (TActorIterator<APawnTank> It(World); It; ++It)
+	{
+		TankCount++;
+	}
+
+	int32 TurretCount = 0;
+	for (TActorIterator<APawnTurret> It(World); It; ++It)
+	{
+		TurretCount++;
+	}
+
+	int32 PickUpActorCount = 0;
+	for (TActorIterator<APickUpBase> It(World); It; ++It)
+	{
+		PickUpActorCount++;
+	}
+
+	UBallisticProjectileSubsystem* BallisticSubsystem = World->GetSubsystem<UBallisticProjectileSubsystem>();
+	UDestructionSubsystem* DestructionSubsystem = World->GetSubsystem<UDestructionSubsystem>();
+	UPickUpSubsystem* PickUpSubsystem = World->GetSubsystem<UPickUpSubsystem>();
+
+	FString Json = TEXT("{\n");
+	Json += FString::Printf(TEXT("\t\"map\": \"%s\",\n"), *World->GetMapName());
+	Json += FString::Printf(TEXT("\t\"frame\": %llu,\n"), Frame.FrameNumber);
+	Json += FString::Printf(TEXT("\t\"frameMs\": %.3f,\n"), FrameMs);
+	Json += FString::Printf(TEXT("\t\"thresholdMs\": %.3f,\n"), CVarHitchThresholdMs.GetValueOnGameThread());
+	Json += FString::Printf(TEXT("\t\"unscopedMs\": %.3f,\n"), FMath::Max(FrameMs - ScopedMs, 0.0));
+	Json += FString::Printf
+	(
+		TEXT("\t\"trigger\": { \"name\": \"%s\", \"ms\": %.3f },\n"),
+		Trigger ? Trigger->Name : TEXT("None"),
+		Trigger ? FPlatformTime::ToMilliseconds64(Trigger->EndCycles - Trigger->StartCycles) : 0.0
+	);
+	Json += FString::Printf
+	(
+		TEXT("\t\"counts\": { \"actors\": %d, \"tanks\": %d, \"turrets\": %d, \"pickUpActors\": %d, \"ballisticProjectiles\": %d, \"pickUps\": %d, \"pendingDestructions\": %d },\n"),
+		ActorCount,
+		TankCount,
+		TurretCount,
+		PickUpActorCount,
+		BallisticSubsystem ? BallisticSubsystem->GetProjectileCount() : 0,
+		PickUpSubsystem ? PickUpSubsystem->GetPickUpCount() : 0,
+		DestructionSubsystem ? DestructionSubsystem->GetPendingDestructionCount() : 0
+	);
+
+	// Oldest frame first, the hitch frame is the last one
+	Json += TEXT("\t\"frames\": [\n");
+	for (int32 Age = RecordedFrames - 1; Age >= 0; Age--)
+	{
+		int32 FrameIndex = (HitchFrame - Age + Frames.Num()) % Frames.Num();
+		Json += FormatFrame(Frames[FrameIndex]);
+		Json += Age > 0 ? TEXT(",\n") : TEXT("\n");
+	}
+	Json += TEXT("\t]\n}\n");
+
+	FString Filename = FPaths::ProjectSavedDir() / TEXT("Hitches") / FString::Printf
+	(
+		TEXT("Hitch_%s_%s_%llu.json"),
+		*FPackageName::GetShortName(World->GetMapName()),
+		*FDateTime::Now().ToString(),
+		Frame.FrameNumber
+	);
+
+	UE_LOG
+	(
+		LogTemp,
+		Warning,
+		TEXT("Hitch: frame %llu took %.2f ms (trigger: %s), saving %d frames to %s"),
+		Frame.FrameNumber,
+		FrameMs,
+		Trigger ? Trigger->Name : TEXT("None"),
+		RecordedFrames,
+		*Filename
+	);
+
+	// Writing the file would only make the next frame hitch too, so it's done on a worker thread
+	Async(EAsyncExecution::ThreadPool, [Json = MoveTemp(Json), Filename]()
+	{
+		FFileHelper::SaveStringToFile(Json, *Filename);
+	});
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		The JSON object of one frame's timeline		////////
+FString UHitchCaptureSubsystem::FormatFrame(const FHitchFrame& Frame) const
+{
+	FString Json = FString::Printf
+	(
+		TEXT("\t\t{ \"frame\": %llu, \"ms\": %.3f, \"droppedEvents\": %d, \"events\": ["),
+		Frame.FrameNumber,
+		FPlatformTime::ToMilliseconds64(Frame.EndCycles - Frame.StartCycles),
+		Frame.DroppedEvents
+	);
+
+	for (int32 EventIndex = 0; EventIndex < Frame.Events.Num(); EventIndex++)
+	{
+		const FHitchEvent& Event = Frame.Events[EventIndex];
+		Json += FString::Printf
+		(
+			TEXT("%s\n\t\t\t{ \"name\": \"%s\", \"depth\": %d, \"startMs\": %.3f, \"ms\": %.3f }"),
+			EventIndex > 0 ? TEXT(",") : TEXT(""),
+			Event.Name,
+			Event.Depth,
+			FPlatformTime::ToMilliseconds64(Event.StartCycles - Frame.StartCycles),
+			FPlatformTime::ToMilliseconds64(Event.EndCycles - Event.StartCycles)
+		);
+	}
+
+	Json += Frame.Events.Num() > 0 ? TEXT("\n\t\t] }") : TEXT("] }");
+	return Json;
+}
+////////////////////////////////////////////////////////////////////////
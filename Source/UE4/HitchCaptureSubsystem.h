@@ -0,0 +1,86 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "HitchCapture.h"
+#include "HitchCaptureSubsystem.generated.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This class keeps the gameplay timeline (every CRAZYTANK_HITCH_SCOPE) of the last frames in a ring buffer.
+// When a frame takes longer than CrazyTank.Hitch.ThresholdMs, that frame and the ones before it are saved
+// as JSON to Saved/Hitches/, with the world's actor counts and the scope that took the longest (the trigger)
+//
+//////////////////////////////////////////////////////////////////////////////
+UCLASS()
+class CRAZYTANK_API UHitchCaptureSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	// One recorded frame of the ring buffer
+	struct FHitchFrame
+	{
+		uint64 FrameNumber = 0;
+
+		uint64 StartCycles = 0;
+
+		uint64 EndCycles = 0;
+
+		int32 DroppedEvents = 0;
+
+		TArray<FHitchEvent> Events; // Kept between frames, so recording doesn't allocate once it has warmed up
+	};
+
+	TArray<FHitchFrame> Frames;
+
+	int32 CurrentFrame = 0; // Frame being recorded in the ring buffer
+
+	int32 RecordedFrames = 0; // Frames in the ring buffer holding a full timeline
+
+	bool bIsFrameOpen = false;
+
+	double LastCaptureTime = -DBL_MAX;
+
+	FDelegateHandle BeginFrameHandle;
+
+	FDelegateHandle EndFrameHandle;
+
+	static UHitchCaptureSubsystem* ActiveCapture; // Only one world records at a time (e.g. the first PIE instance)
+
+	/*
+		METHODS
+	*/
+
+	void OnBeginFrame(); // Starts recording a new frame in the ring buffer
+
+	void OnEndFrame(); // Closes the frame and saves a capture if it went over the threshold
+
+	void SaveCapture(int32 HitchFrame); // Writes the hitch frame and the ones before it to Saved/Hitches/
+
+	FString FormatFrame(const FHitchFrame& Frame) const; // The JSON object of one frame's timeline
+
+public:
+
+	/*
+		METHODS
+	*/
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override; // Starts recording in game worlds
+
+	virtual void Deinitialize() override; // Called when the world is torn down
+
+};
@@ -0,0 +1,89 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "InstancedVisualPool.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+
+////////		Adds the visual of the next kind		////////
+void FInstancedVisualPool::AddVisual(UWorld* World, UStaticMesh* Mesh)
+{
+	UInstancedStaticMeshComponent* Visual = nullptr;
+	if (Mesh && World && World->GetNetMode() != NM_DedicatedServer)
+	{
+		if (!VisualsActor)
+		{
+			FActorSpawnParameters SpawnParams;
+			SpawnParams.ObjectFlags |= RF_Transient;
+			VisualsActor = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+		}
+
+		// Instances are only something to look at, that's the whole point of not using Actors
+		Visual = NewObject<UInstancedStaticMeshComponent>(VisualsActor);
+		Visual->SetMobility(EComponentMobility::Movable);
+		Visual->SetStaticMesh(Mesh);
+		Visual->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		Visual->SetCastShadow(false);
+		Visual->RegisterComponent();
+		VisualsActor->AddInstanceComponent(Visual);
+	}
+	Visuals.Add(Visual);
+}
+////////////////////////////////////////////////////////////////////////
+
+bool FInstancedVisualPool::HasVisual(int32 VisualIndex) const
+{
+	return Visuals.IsValidIndex(VisualIndex) && Visuals[VisualIndex] != nullptr;
+}
+
+TArray<FTransform>& FInstancedVisualPool::ResetInstanceTransforms()
+{
+	InstanceTransforms.Reset();
+	return InstanceTransforms;
+}
+
+////////		Moves the instances of one kind to the filled transforms		////////
+void FInstancedVisualPool::UpdateVisual(int32 VisualIndex)
+{
+	if (!HasVisual(VisualIndex))
+	{
+		return;
+	}
+
+	UInstancedStaticMeshComponent* Visual = Visuals[VisualIndex];
+	const int32 UsedInstances = InstanceTransforms.Num();
+	const int32 ExistingInstances = Visual->GetInstanceCount();
+	if (UsedInstances == 0 && ExistingInstances == 0)
+	{
+		return;
+	}
+
+	// The instances not used anymore are hidden by scaling them down to nothing
+	for (int32 InstanceIndex = UsedInstances; InstanceIndex < ExistingInstances; InstanceIndex++)
+	{
+		InstanceTransforms.Emplace(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+	}
+
+	for (int32 InstanceIndex = ExistingInstances; InstanceIndex < UsedInstances; InstanceIndex++)
+	{
+		Visual->AddInstanceWorldSpace(InstanceTransforms[InstanceIndex]);
+	}
+
+	Visual->BatchUpdateInstancesTransforms(0, InstanceTransforms, true, true, true);
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Forgets every visual		////////
+void FInstancedVisualPool::Reset()
+{
+	Visuals.Empty();
+	InstanceTransforms.Empty();
+	VisualsActor = nullptr;
+}
+////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,66 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "InstancedVisualPool.generated.h"
+
+/*
+
+	Engine classes
+
+*/
+
+class UInstancedStaticMeshComponent;
+class UStaticMesh;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// One instanced mesh component per kind of thing drawn without an Actor (simulated projectiles, dropped Pick Ups...),
+// all owned by a single transient Actor. The instances are placed in world space, never collide and are never removed:
+// the ones not used are scaled down to nothing, so a component only grows up to the most instances it ever drew at once
+//
+//////////////////////////////////////////////////////////////////////////////
+USTRUCT()
+struct CRAZYTANK_API FInstancedVisualPool
+{
+	GENERATED_BODY()
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	UPROPERTY()
+	TArray<UInstancedStaticMeshComponent*> Visuals; // One per kind (null when it isn't drawn)
+
+	UPROPERTY()
+	AActor* VisualsActor = nullptr; // Owner of the instanced mesh components
+
+	TArray<FTransform> InstanceTransforms; // Kept between updates so the visuals don't allocate once they have warmed up
+
+public:
+
+	/*
+		METHODS
+	*/
+
+	// Adds the visual of the next kind, nothing is drawn for it without a mesh or on a dedicated server
+	void AddVisual(UWorld* World, UStaticMesh* Mesh);
+
+	bool HasVisual(int32 VisualIndex) const; // False when the kind isn't drawn, its instances don't need to be gathered
+
+	TArray<FTransform>& ResetInstanceTransforms(); // Empties the transforms to fill for the next UpdateVisual()
+
+	void UpdateVisual(int32 VisualIndex); // Moves the instances of one kind to the filled transforms
+
+	void Reset(); // Forgets every visual (the world is torn down)
+
+};
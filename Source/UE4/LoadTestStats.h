@@ -0,0 +1,68 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Gameplay systems whose game thread time is broken down by the server load test
+enum class ELoadTestSystem : uint8
+{
+	Tanks,
+	Turrets,
+	Bots,
+	Destruction,
+	Projectiles,
+	PickUps,
+	Count
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Per-system time accumulated during the current frame while the server load test is recording
+// (game thread only, the values are reset by ATankLoadTestGameMode every frame)
+//
+//////////////////////////////////////////////////////////////////////////////
+struct CRAZYTANK_API FLoadTestStats
+{
+	static bool bIsRecording; // When false, the scopes below don't even read the clock
+
+	static double SystemSeconds[(int32)ELoadTestSystem::Count];
+
+	static const TCHAR* GetSystemName(ELoadTestSystem System);
+
+	static void ResetFrame();
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Adds the time spent inside the scope to its system's total while the load test is recording
+//
+//////////////////////////////////////////////////////////////////////////////
+struct FLoadTestScope
+{
+	FORCEINLINE explicit FLoadTestScope(ELoadTestSystem InSystem)
+		: System(InSystem)
+		, StartTime(FLoadTestStats::bIsRecording ? FPlatformTime::Seconds() : 0.0)
+	{
+	}
+
+	FORCEINLINE ~FLoadTestScope()
+	{
+		if (StartTime != 0.0)
+		{
+			FLoadTestStats::SystemSeconds[(int32)System] += FPlatformTime::Seconds() - StartTime;
+		}
+	}
+
+private:
+
+	ELoadTestSystem System;
+
+	double StartTime;
+};
@@ -15,6 +15,89 @@
 #include "Particles/ParticleSystemComponent.h" 
 #include "CrazyTank/Actors/GunBase.h"
 #include "CrazyTank/Actors/ProjectileBase.h"
+#include "LoadTestStats.h"
+#include "EffectBudgetSubsystem.h"
+#include "PickUpSubsystem.h"
+#include "TurretAimSubsystem.h"
+#include "DestructionSubsystem.h"
+#include "HitchCapture.h"
+#include "Framework/Application/SlateApplication.h"
+#include "Rendering/SlateRenderer.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "HAL/IConsoleManager.h"
+
+/*
+
+	Input-to-present latency marker
+
+*/
+
+// Logs the turret aim's input-to-present latency of the locally controlled Tank every frame
+static TAutoConsoleVariable<int32> CVarLogAimLatency
+(
+	TEXT("CrazyTank.Aim.LogLatency"),
+	0,
+	TEXT("When 1, logs the time from the turret's mouse input reaching gameplay code (RotateView) to the frame showing it being presented.\n")
+	TEXT("The time the input spent in the OS and in the engine's input processing before RotateView isn't included."),
+	ECVF_Default
+);
+
+static uint64 GAimInputCyclesRenderThread = 0; // Input timestamp of the frame the render thread is working on
+
+static TAtomic<uint32> GAimInputToPresentMicroseconds(0); // Last measured latency, written by the render thread
+
+// Called on the render thread when a frame is about to be presented
+static void OnAimBackBufferReadyToPresent(SWindow& Window, const FTexture2DRHIRef& BackBuffer)
+{
+	if (GAimInputCyclesRenderThread == 0)
+	{
+		return;
+	}
+
+	double LatencyMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - GAimInputCyclesRenderThread);
+	GAimInputCyclesRenderThread = 0;
+
+	GAimInputToPresentMicroseconds = (uint32)(LatencyMs * 1000.0);
+	CSV_CUSTOM_STAT_GLOBAL(TankAimInputToPresentMs, (float)LatencyMs, ECsvCustomStatOp::Set);
+}
+
+// Hooks the latency marker to the Slate renderer's present, only once and only when there's something being rendered
+static void RegisterAimLatencyMarker()
+{
+	static bool bIsRegistered = false;
+	if (bIsRegistered || !FSlateApplication::IsInitialized() || !FSlateApplication::Get().GetRenderer())
+	{
+		return;
+	}
+
+	FSlateApplication::Get().GetRenderer()->OnBackBufferReadyToPresent().AddStatic(&OnAimBackBufferReadyToPresent);
+	bIsRegistered = true;
+}
+
+/*
+
+	FTankAimLatchTickFunction
+
+*/
+
+void FTankAimLatchTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Tank && !Tank->IsPendingKill())
+	{
+		Tank->LatchTurretAim();
+	}
+}
+
+FString FTankAimLatchTickFunction::DiagnosticMessage()
+{
+	return Tank ? Tank->GetFullName() + TEXT("[LatchTurretAim]") : TEXT("<null>[LatchTurretAim]");
+}
+
+/*
+
+	APawnTank
+
+*/
 
 ////////		Sets default values for this pawn's properties	////////
 APawnTank::APawnTank()
@@ -44,6 +127,9 @@ void APawnTank::BeginPlay()
 {
 	Super::BeginPlay();
 
+	// "PawnBase" would play its own death particle on top of the budgeted explosion, so the budget takes it over
+	DestructionEffect = UEffectBudgetSubsystem::TakeOverDestructionEffect(this, APawnBase::StaticClass(), DestructionEffect);
+
 	PlayerControllerRef = Cast<APlayerController>(GetController());
 	if (PlayerControllerRef)
 	{
@@ -63,6 +149,45 @@ void APawnTank::BeginPlay()
 
 	ParticleTrail->DeactivateSystem();
 
+	// The dust trail is emitting only when the effect budget allows it (it's close and on screen, and there are free slots)
+	EffectBudget = GetWorld()->GetSubsystem<UEffectBudgetSubsystem>();
+	if (EffectBudget)
+	{
+		EffectBudget->RegisterEffect(ParticleTrail, EEffectCategory::DustTrail);
+	}
+
+	// Dropped Pick Ups are collected by one radius query around the Tank every frame, instead of each one overlapping it
+	UPickUpSubsystem* PickUpSubsystem = GetWorld()->GetSubsystem<UPickUpSubsystem>();
+	if (PickUpSubsystem)
+	{
+		PickUpSubsystem->RegisterCollector(this);
+	}
+
+	// Turrets target the closest live Tank they know of, so the bots of the load test are shot at like the player
+	UTurretAimSubsystem* AimSubsystem = GetWorld()->GetSubsystem<UTurretAimSubsystem>();
+	if (AimSubsystem)
+	{
+		AimSubsystem->RegisterTarget(this);
+	}
+
+	// The turret's mouse rotation is applied in a late tick, after the Tank's own Tick (Rotate() and Move()).
+	// It runs in the post physics group, before the spring arm places the camera and before the player's camera manager
+	// is updated (that happens between the post physics and post update work groups), so the rendered view shows this frame's input
+	AimLatchTickFunction.Tank = this;
+	AimLatchTickFunction.bCanEverTick = true;
+	AimLatchTickFunction.TickGroup = TG_PostPhysics;
+	AimLatchTickFunction.RegisterTickFunction(GetLevel());
+	AimLatchTickFunction.AddPrerequisite(this, PrimaryActorTick);
+	SpringArm->PrimaryComponentTick.AddPrerequisite(this, AimLatchTickFunction);
+
+	AimSnapshotLocation = projectileSpawnPoint->GetComponentLocation();
+	AimSnapshotDirection = projectileSpawnPoint->GetForwardVector();
+
+	if (PlayerControllerRef && PlayerControllerRef->IsLocalController())
+	{
+		RegisterAimLatencyMarker();
+	}
+
 	ProjectileAmmoCurrent = ProjectileAmmoMax;
 	HomingProjectileAmmoCurrent = HomingProjectileAmmoMax;
 
@@ -75,11 +200,40 @@ void APawnTank::BeginPlay()
 }
 ///////////////////////////////////////////////////////////////////////////
 
+////////		Called when the Tank is removed from the world		////////
+void APawnTank::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	AimLatchTickFunction.UnRegisterTickFunction();
+
+	if (EffectBudget)
+	{
+		EffectBudget->UnregisterEffect(ParticleTrail);
+	}
+
+	UPickUpSubsystem* PickUpSubsystem = GetWorld()->GetSubsystem<UPickUpSubsystem>();
+	if (PickUpSubsystem)
+	{
+		PickUpSubsystem->UnregisterCollector(this);
+	}
+
+	UTurretAimSubsystem* AimSubsystem = GetWorld()->GetSubsystem<UTurretAimSubsystem>();
+	if (AimSubsystem)
+	{
+		AimSubsystem->UnregisterTarget(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+///////////////////////////////////////////////////////////////////////////
+
 ////////		Called every frame		////////
 void APawnTank::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	FLoadTestScope LoadTestScope(ELoadTestSystem::Tanks);
+	CRAZYTANK_HITCH_SCOPE("Tank.Tick");
+
 	Rotate();
 	Move();
 }
@@ -124,12 +278,63 @@ void APawnTank::CalculateRotateInput(float value)
 }
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-////////		Calculates and applies the Tank's turret rotation from mouse input and turn speed		////////
+////////		Calculates the Tank's turret rotation from mouse input and turn speed		////////
+////////		The rotation is only stored here, LatchTurretAim() applies it after the Tank's Tick		////////
 void APawnTank::RotateView(float value)
 {
-	float RotateAmount = value * TurnSpeed * GetWorld()->DeltaTimeSeconds;
-	FRotator Rotation = FRotator(0, RotateAmount, 0); //rotate around yaw/up vector
-	TurretMesh->AddLocalRotation(Rotation);
+	if (value == 0.0f)
+	{
+		return;
+	}
+
+	if (PendingAimInputCycles == 0 && PlayerControllerRef)
+	{
+		// Remember when this frame's first mouse rotation arrived, for the input-to-present latency marker (players only, not bots)
+		PendingAimInputCycles = FPlatformTime::Cycles64();
+	}
+
+	// Accumulate the rotation around yaw/up vector instead of applying it to the turret right away
+	PendingTurretYaw += value * TurnSpeed * GetWorld()->DeltaTimeSeconds;
+}
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////		Applies the turret's pending mouse rotation right before the spring arm and the camera are updated		////////
+////////		Also takes the aim snapshot used by gameplay logic such as TargetHomingProjectile()		////////
+void APawnTank::LatchTurretAim()
+{
+	CRAZYTANK_HITCH_SCOPE("Tank.LatchTurretAim");
+
+	if (PendingTurretYaw != 0.0f)
+	{
+		// Rotate() already applied the body's counter rotation, the mouse rotation goes on top of it
+		TurretMesh->AddLocalRotation(FRotator(0.0f, PendingTurretYaw, 0.0f));
+		PendingTurretYaw = 0.0f;
+	}
+
+	// Gameplay logic running before the next latch sees the aim the player is looking at, not a half-updated one
+	AimSnapshotLocation = projectileSpawnPoint->GetComponentLocation();
+	AimSnapshotDirection = projectileSpawnPoint->GetForwardVector();
+
+	if (PendingAimInputCycles == 0)
+	{
+		return;
+	}
+
+	// Hand the input timestamp over to the render thread, it'll be measured against this frame's present
+	uint64 InputCycles = PendingAimInputCycles;
+	PendingAimInputCycles = 0;
+	ENQUEUE_RENDER_COMMAND(TankAimLatchMarker)
+	(
+		[InputCycles](FRHICommandListImmediate& RHICmdList)
+		{
+			GAimInputCyclesRenderThread = InputCycles;
+		}
+	);
+
+	if (CVarLogAimLatency.GetValueOnGameThread() != 0)
+	{
+		UE_LOG(LogTemp, Display, TEXT("Turret aim input-to-present: %.2f ms"), GAimInputToPresentMicroseconds.Load() / 1000.0f);
+	}
 }
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -137,6 +342,8 @@ void APawnTank::RotateView(float value)
 ////////		Also applies a force to move the Tank if it's grounded or a down force (gravity) in case it's not		////////
 void APawnTank::Move()
 {
+	CRAZYTANK_HITCH_SCOPE("Tank.Move");
+
 	bIsGrounded = false;
 	FHitResult Hit;
 
@@ -198,13 +405,12 @@ void APawnTank::Move()
 ////////		only if the Tank is moving first, if not it won't rotate		////////
 void APawnTank::Rotate()
 {
+	CRAZYTANK_HITCH_SCOPE("Tank.Rotate");
+
 	if (MoveDirection != FVector::ZeroVector && bIsGrounded)
 	{
 		// If the Tank is moving and is grounded, emit a dust particle trail
-		if (ParticleTrail->bWasDeactivated && !ParticleTrail->bWasActive)
-		{
-			ParticleTrail->Activate(true);
-		}
+		SetDustTrailWanted(true);
 
 		if(MoveDirection.X > 0.0f)
 		{
@@ -225,11 +431,29 @@ void APawnTank::Rotate()
 	else
 	{
 		// If the Tank isn't moving or isn't grounded, deactivate the emission of the dust particle trail
-		if(!ParticleTrail->bWasDeactivated)
-		{
-			ParticleTrail->bSuppressSpawning = true;
-			ParticleTrail->Deactivate();
-		}
+		SetDustTrailWanted(false);
+	}
+}
+///////////////////////////////////////////////////////////////////////////////////////////////
+
+////////		Asks the effect budget to start or stop the dust trail, only when that changes		////////
+void APawnTank::SetDustTrailWanted(bool bWanted)
+{
+	if (bWantsDustTrail == bWanted)
+	{
+		return;
+	}
+
+	bWantsDustTrail = bWanted;
+
+	if (EffectBudget)
+	{
+		EffectBudget->SetEffectWanted(ParticleTrail, bWanted);
+	}
+	else
+	{
+		// Without a budget (e.g. no world subsystems) the trail is simply turned on and off
+		UEffectBudgetSubsystem::SetEmitting(ParticleTrail, bWanted);
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -237,6 +461,8 @@ void APawnTank::Rotate()
 ////////		Activates the firing of the Tank's gun if there's a Gun Class assigned		////////
 void APawnTank::FireRifle()
 {
+	CRAZYTANK_HITCH_SCOPE("Tank.FireRifle");
+
 	if (GunClass)
 	{
 		Gun->PullTrigger();
@@ -247,9 +473,21 @@ void APawnTank::FireRifle()
 ////////	////			Manages this pawn's behaviour when it's destroyed		/////////////////////////
 void APawnTank::HandleDestruction()
 {
+	CRAZYTANK_HITCH_SCOPE("Tank.HandleDestruction");
+
 	//Call "PawnBase" class HandleDestruction() to play effects
 	Super::HandleDestruction();
 
+	// The explosion is played here instead of in "PawnBase", so it goes through the effect budget
+	UEffectBudgetSubsystem::SpawnOneShotInWorld(GetWorld(), EEffectCategory::Destruction, DestructionEffect, GetActorLocation(), GetActorRotation());
+
+	// The explosion damage is queued like the Turrets' one, so Tanks destroyed by it explode in a later frame instead of recursing in this one
+	UDestructionSubsystem* DestructionSubsystem = GetWorld()->GetSubsystem<UDestructionSubsystem>();
+	if (DestructionSubsystem && ExplosionRadius > 0.0f)
+	{
+		DestructionSubsystem->QueueDestruction(this, FSimpleDelegate::CreateUObject(this, &APawnTank::Explode));
+	}
+
 	//// Overriding logic in this child class ////
 
 	bIsPlayerAlive = false;
@@ -259,9 +497,37 @@ void APawnTank::HandleDestruction()
 
 	//Stop running Tick functionality to save some performance and also stop movement and rotation
 	SetActorTickEnabled(false);
+	AimLatchTickFunction.SetTickFunctionEnable(false);
+
+	SetDustTrailWanted(false);
+
+	UPickUpSubsystem* PickUpSubsystem = GetWorld()->GetSubsystem<UPickUpSubsystem>();
+	if (PickUpSubsystem)
+	{
+		PickUpSubsystem->UnregisterCollector(this);
+	}
+
+	UTurretAimSubsystem* AimSubsystem = GetWorld()->GetSubsystem<UTurretAimSubsystem>();
+	if (AimSubsystem)
+	{
+		AimSubsystem->UnregisterTarget(this);
+	}
 }
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+////////		Damages the Actors around the destroyed Tank		////////
+void APawnTank::Explode()
+{
+	CRAZYTANK_HITCH_SCOPE("Tank.Explode");
+
+	UDestructionSubsystem* DestructionSubsystem = GetWorld()->GetSubsystem<UDestructionSubsystem>();
+	if (DestructionSubsystem)
+	{
+		DestructionSubsystem->ApplyRadialDamage(GetActorLocation(), ExplosionRadius, ExplosionDamage, 0.0f, this, GetInstigatorController(), nullptr);
+	}
+}
+////////////////////////////////////////////////////////////////
+
 //////////		Getter for the bIsPlayerAlive variable		//////////
 bool APawnTank::GetIsPlayerAlive()
 {
@@ -299,31 +565,89 @@ void APawnTank::AddAmmo(int AmmoType, int Amount)
 }
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+////////////		Feeds driving and turret input to the Tank the same way the player's input bindings do		////////////
+void APawnTank::SetBotInput(float MoveValue, float TurnValue, float TurretValue)
+{
+	CalculateMoveInput(MoveValue);
+	CalculateRotateInput(TurnValue);
+	RotateView(TurretValue);
+}
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////		Fires a regular projectile on behalf of a bot controller		////////
+void APawnTank::BotFire()
+{
+	Fire();
+}
+////////////////////////////////////////////////////////////////////////////////////////
+
+////////		Looks for a homing target on behalf of a bot controller		////////
+void APawnTank::BotTargetHomingProjectile()
+{
+	TargetHomingProjectile();
+}
+////////////////////////////////////////////////////////////////////////////////////////
+
+////////		Fires the homing projectiles on behalf of a bot controller		////////
+void APawnTank::BotFireHomingProjectile()
+{
+	FireHomingProjectile();
+}
+////////////////////////////////////////////////////////////////////////////////////////
+
+//////////		Getters for the current ammo of both projectile types		//////////
+int APawnTank::GetProjectileAmmo() const
+{
+	return ProjectileAmmoCurrent;
+}
+
+int APawnTank::GetHomingProjectileAmmo() const
+{
+	return HomingProjectileAmmoCurrent;
+}
+//////////////////////////////////////////////////////////////////////////////////////
+
+//////////		Directions the Tank's base and turret are facing		//////////
+FVector APawnTank::GetBodyForwardVector() const
+{
+	return BaseMesh->GetForwardVector();
+}
+
+FVector APawnTank::GetAimForwardVector() const
+{
+	return projectileSpawnPoint->GetForwardVector();
+}
+//////////////////////////////////////////////////////////////////////////////////////
+
 ///////////////////		Sends a raycast to find enemies to target for the Tank's homing projectile		///////////////////
 ////////		Also draws an outline to every found target		////////
 void APawnTank::TargetHomingProjectile()
 {
+	CRAZYTANK_HITCH_SCOPE("Tank.TargetHomingProjectile");
+
 	if (HomingProjectileAmmoCurrent > 0)
 	{
 		// If the Tank currently have some homing projectiles ammo, it'll send a forward Line Trace to find enemy targets
 		FHitResult HitRes = FHitResult();
-		TArray<TEnumAsByte<EObjectTypeQuery>> ObjectsToTarget; // Any traced enemy will be saved in this array
-		ObjectsToTarget.Add(ObjectTypeQuery1); // Static Mesh object type
-		FVector EndPointTrace = projectileSpawnPoint->GetComponentLocation() + (projectileSpawnPoint->GetForwardVector() * 100000.0f);
+		// Only Static Mesh object types can be targeted (built straight from the channel, so no array is allocated on every press)
+		FCollisionObjectQueryParams ObjectsToTarget(UEngineTypes::ConvertToCollisionChannel(ObjectTypeQuery1));
+		// Trace from the aim snapshot taken when the last frame was rendered, so the target is the one the player was looking at
+		FVector EndPointTrace = AimSnapshotLocation + (AimSnapshotDirection * 100000.0f);
 		
 		// visual representation of the trace for debbuging purposes
-		DrawDebugLine(GetWorld(), projectileSpawnPoint->GetComponentLocation(), EndPointTrace, FColor::Yellow, false, 0.5, 0, 2.0f);
+		DrawDebugLine(GetWorld(), AimSnapshotLocation, EndPointTrace, FColor::Yellow, false, 0.5, 0, 2.0f);
 
 		// Perform the Line Trace and save its results as a bool
 		bool bTargetFound = GetWorld()->LineTraceSingleByObjectType
 		(
 			HitRes,
-			projectileSpawnPoint->GetComponentLocation(),
+			AimSnapshotLocation,
 			EndPointTrace,
 			ObjectsToTarget
 		);
 
-		UE_LOG(LogTemp, Error, TEXT("%s"), bTargetFound ? TEXT("true") : TEXT("false"));
+		// Verbose, so nothing is formatted on every press unless the log category is turned up
+		UE_LOG(LogTemp, Verbose, TEXT("Homing target trace hit: %s"), bTargetFound ? TEXT("true") : TEXT("false"));
 
 		if (!bTargetFound)
 		{
@@ -346,7 +670,7 @@ void APawnTank::TargetHomingProjectile()
 			return;
 		}
 
-		UE_LOG(LogTemp, Error, TEXT("TARGET IS %s"), *HitRes.GetActor()->GetName());
+		UE_LOG(LogTemp, Verbose, TEXT("Homing target is %s"), *HitRes.GetActor()->GetName());
 
 		
 		if (HomingTarget.Num() >= HomingProjectileAmmoCurrent)
@@ -381,6 +705,8 @@ void APawnTank::TargetHomingProjectile()
 ////////////////////////			Spawns and shoots a homing projectile for every found target			////////////////////////
 void APawnTank::FireHomingProjectile()
 {
+	CRAZYTANK_HITCH_SCOPE("Tank.FireHomingProjectile");
+
 	if (HomingTarget.Num() == 0)
 	{
 		// If there're not targets, exit the function
@@ -459,10 +785,21 @@ void APawnTank::DrawTargetOutline(AActor* Target, bool bShouldDraw)
 //////		Activates the firing of the Tank's regular projectiles using the "PawnBase" parent class virtual method		//////
 void APawnTank::Fire()
 {
+	CRAZYTANK_HITCH_SCOPE("Tank.Fire");
+
 	if (ProjectileAmmoCurrent > 0)
 	{
-		// If the Tank has regular projectiles ammo, call "PawnBase" class Fire() to handle their shooting
-		Super::Fire();
+		UBallisticProjectileSubsystem* BallisticSubsystem = GetWorld()->GetSubsystem<UBallisticProjectileSubsystem>();
+		if (bUseBallisticProjectiles && BallisticSubsystem && BallisticSubsystem->IsSimulationAllowed())
+		{
+			// If the Tank uses simulated projectiles, let the Ballistic Projectile Subsystem handle their shooting
+			FireBallisticProjectile(BallisticSubsystem);
+		}
+		else
+		{
+			// If the Tank has regular projectiles ammo, call "PawnBase" class Fire() to handle their shooting
+			Super::Fire();
+		}
 
 		// Update the current regular projectile ammo count after every shot and notify subscribed classes about that change
 		ProjectileAmmoCurrent = ProcessNewAmmo(ProjectileAmmoCurrent, -1, ProjectileAmmoMax);
@@ -477,6 +814,24 @@ void APawnTank::Fire()
 }
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+//////		Fires a regular projectile simulated by the Ballistic Projectile Subsystem (no projectile Actor)		//////
+void APawnTank::FireBallisticProjectile(UBallisticProjectileSubsystem* BallisticSubsystem)
+{
+	if (BallisticProjectileType == INDEX_NONE)
+	{
+		BallisticProjectileType = BallisticSubsystem->RegisterProjectileType(BallisticProjectile);
+	}
+
+	BallisticSubsystem->FireProjectile
+	(
+		BallisticProjectileType,
+		projectileSpawnPoint->GetComponentLocation(),
+		projectileSpawnPoint->GetComponentRotation(),
+		this
+	);
+}
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 //////		Calculates the current ammo of projectiles (homing or regular) depending on whether the Tank is shooting or getting ammo pick ups		//////
 int APawnTank::ProcessNewAmmo(int CurrentAmmo, int AddedAmount, int MaxAmmo)
 {
@@ -10,6 +10,7 @@
 
 #include "CoreMinimal.h"
 #include "PawnBase.h"
+#include "BallisticProjectileSubsystem.h"
 #include "PawnTank.generated.h"
 
 /*
@@ -28,6 +29,34 @@ class UCameraComponent;
 */
 
 class AGunBase;
+class UEffectBudgetSubsystem;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Late tick of the Tank (post physics) that applies the turret's mouse rotation just before the spring arm
+// and the camera manager are updated, so the rendered view shows the freshest input (see APawnTank::LatchTurretAim())
+//
+//////////////////////////////////////////////////////////////////////////////
+USTRUCT()
+struct FTankAimLatchTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	class APawnTank* Tank = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FTankAimLatchTickFunction> : public TStructOpsTypeTraitsBase2<FTankAimLatchTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
 
 // Delegate to notify suscribed classes when the current Tank's regular projectiles amount has changed
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnProjectileCountChanged, int32, ProjectileCount);
@@ -60,12 +89,36 @@ private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components", meta = (AllowPrivateAccess = "true"))
 	UParticleSystemComponent* ParticleTrail = nullptr; // Dust trail made by the Tank when moving
 
+	UEffectBudgetSubsystem* EffectBudget = nullptr; // Decides if the dust trail can actually emit when the Tank wants it to
+
+	bool bWantsDustTrail = false; // Whether the Tank is currently asking for its dust trail
+
+	// Explosion played through the effect budget when the Tank is destroyed (when empty, the "PawnBase" death particle is played through it instead)
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Effects", meta = (AllowPrivateAccess = "true"))
+	UParticleSystem* DestructionEffect = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat", meta = (AllowPrivateAccess = "true", ClampMin = "0"))
+	float ExplosionRadius = 0.0f; // Actors this close are damaged when the Tank is destroyed (0 for no explosion damage)
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat", meta = (AllowPrivateAccess = "true"))
+	float ExplosionDamage = 30.0f; // Damage at the Tank's location, it goes down linearly to 0 at ExplosionRadius
+
 	FVector MoveDirection = FVector::ZeroVector;
 
 	FQuat RotationDirection = FQuat::Identity; // The Tank's body rotation direction given by the WASD keys input
 
 	FQuat CounterRotation = FQuat::Identity; // The Tank's turret rotation direction given by the mouse input
 
+	float PendingTurretYaw = 0.0f; // Mouse rotation received this frame, applied to the turret as late as possible
+
+	uint64 PendingAimInputCycles = 0; // When the first mouse rotation of this frame was received, for measuring input latency
+
+	FTankAimLatchTickFunction AimLatchTickFunction; // Applies PendingTurretYaw after the Tank's Tick, before the camera is placed
+
+	FVector AimSnapshotLocation = FVector::ZeroVector; // Where the turret was aiming from when the last frame was rendered
+
+	FVector AimSnapshotDirection = FVector::ForwardVector; // Where the turret was aiming to when the last frame was rendered
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Movement", meta = (AllowPrivateAccess = "true"))
 	float MoveSpeed = 100.0f;
 
@@ -91,9 +144,31 @@ private:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile Type", meta = (AllowPrivateAccess = "true"))
 	TSubclassOf<AProjectileBase> HomingProjectileClass;
 
+	// When true, regular projectiles are simulated by the Ballistic Projectile Subsystem instead of spawning projectile Actors.
+	// They aren't replicated, so networked games still spawn the projectile Actors
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile Type", meta = (AllowPrivateAccess = "true"))
+	bool bUseBallisticProjectiles = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile Type", meta = (AllowPrivateAccess = "true", EditCondition = "bUseBallisticProjectiles"))
+	FBallisticProjectileParams BallisticProjectile; // Regular projectile settings used by the Ballistic Projectile Subsystem
+
+	int32 BallisticProjectileType = INDEX_NONE; // Index of BallisticProjectile in the Ballistic Projectile Subsystem
+
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components", meta = (AllowPrivateAccess = "true"))
 	USceneComponent* HomingProjectileSpawnPoint = nullptr; //visual representation of where homing projectiles will be spawned from when fired
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pick Ups", meta = (AllowPrivateAccess = "true"))
+	float PickUpCollectRadius = 150.0f; // Pick Ups closer than this to the Tank are collected
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pick Ups", meta = (AllowPrivateAccess = "true"))
+	float PickUpMagnetRadius = 500.0f; // Pick Ups closer than this are pulled towards the Tank (no pull when it's not above PickUpCollectRadius)
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pick Ups", meta = (AllowPrivateAccess = "true"))
+	float PickUpMagnetSpeed = 800.0f; // How fast the pulled Pick Ups move towards the Tank
+
+	// The Pick Up Subsystem reads the Pick Up radii of every Tank when collecting
+	friend class UPickUpSubsystem;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Projectile Type", meta = (AllowPrivateAccess = "true"))
 	int ProjectileAmmoMax = 6;
 
@@ -120,7 +195,8 @@ private:
 	// Calculate the Tank's body rotation from keyboard input and turn speed
 	void CalculateRotateInput(float value); // Also calculates the counter rotation for the Tank's turret from the results of the body rotation
 	
-	void RotateView(float value); // Calculates and applies the Tank's turret rotation from mouse input and turn speed
+	// Calculates the Tank's turret rotation from mouse input and turn speed
+	void RotateView(float value); // The rotation is only stored here, LatchTurretAim() applies it after the Tank's Tick
 	
 	// Raycast down from the Tank's body to know if it's grounded and align its body to the surface if that's the case  
 	void Move(); // Also applies a force to move the Tank if it's grounded or a down force (gravity) in case it's not 
@@ -128,6 +204,8 @@ private:
 	// Applies the rotation and counter rotation of the Tank's base and turret, only if the Tank is moving first, if not it'll not rotate
 	void Rotate(); // Also manages a dust particle system when the Tank is moving
 
+	void SetDustTrailWanted(bool bWanted); // Asks the effect budget to start or stop the dust trail, only when that changes
+
 	void FireRifle(); // Activates the firing of the Tank's gun if there's a Gun Class assigned
 	
 	// Sends a raycast to find enemies to target for the Tank's homing projectile
@@ -138,10 +216,15 @@ private:
 	void DrawTargetOutline(AActor* Target, bool bShouldDraw); // Draws an outline to every found target mesh
 	
 	virtual void Fire() override; // Activates the firing of the Tank's regular projectiles using the "PawnBase" parent class virtual method
+
+	void FireBallisticProjectile(UBallisticProjectileSubsystem* BallisticSubsystem); // Fires a regular projectile simulated by the Ballistic Projectile Subsystem (no projectile Actor)
 	
 	// Calculates the current ammo of a projectile (homing or regular) depending on whether the player is shooting or recolecting ammo pick ups
 	int ProcessNewAmmo(int CurrentAmmo, int AddedAmount, int MaxAmmo);
 
+	// Damages the Actors around the destroyed Tank
+	void Explode(); // Called by the Destruction Subsystem in a later frame, so Tanks destroyed by it don't chain their explosions in this one
+
 public:
 
 	/*
@@ -159,8 +242,28 @@ public:
 
 	bool GetIsPlayerAlive(); // Getter for the bIsPlayerAlive variable
 
+	// Applies the turret's pending mouse rotation right before the spring arm and the camera are updated
+	void LatchTurretAim(); // Also takes the aim snapshot used by gameplay logic such as TargetHomingProjectile()
+
 	// Adds ammo to a specified type of projectile (homing or regular)
-	void AddAmmo(int AmmoType, int Amount); // This method is public because it's used in the Pick Up classes
+	void AddAmmo(int AmmoType, int Amount); // This method is public because it's used in the Pick Up classes and the Pick Up Subsystem
+
+	// Feeds driving and turret input to the Tank the same way the player's input bindings do
+	void SetBotInput(float MoveValue, float TurnValue, float TurretValue); // Used by bot controllers (e.g. the server load test)
+
+	void BotFire(); // Fires a regular projectile on behalf of a bot controller
+
+	void BotTargetHomingProjectile(); // Looks for a homing target on behalf of a bot controller
+
+	void BotFireHomingProjectile(); // Fires the homing projectiles on behalf of a bot controller
+
+	int GetProjectileAmmo() const; // Getter for the current regular projectiles ammo
+
+	int GetHomingProjectileAmmo() const; // Getter for the current homing projectiles ammo
+
+	FVector GetBodyForwardVector() const; // Direction the Tank's base is facing (where it drives to)
+
+	FVector GetAimForwardVector() const; // Direction the Tank's turret is aiming at (where it shoots to)
 
 	// Delegate to notify suscribed classes when the current Tank's regular projectiles amount has changed
 	UPROPERTY(BlueprintAssignable, BlueprintCallable, Category = "Delegates")
@@ -179,4 +282,6 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override; // Called when the Tank is removed from the world
+
 };
@@ -10,12 +10,19 @@
 #include "Kismet/GameplayStatics.h"
 #include "CrazyTank/Actors/PickUpBase.h"
 #include "PawnTank.h"
+#include "DestructionSubsystem.h"
+#include "LoadTestStats.h"
+#include "EffectBudgetSubsystem.h"
+#include "TurretAimSubsystem.h"
+#include "TurretPlacementTable.h"
+#include "HitchCapture.h"
 
 
  ////////		Sets default values for this pawn's properties	////////
 APawnTurret::APawnTurret()
 {
-
+	// Turrets don't need to tick, their aiming is solved for all of them at once by the Turret Aim Subsystem
+	PrimaryActorTick.bCanEverTick = false;
 }
 ////////////////////////////////////////////////////////////////////////
 
@@ -24,8 +31,8 @@ void APawnTurret::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// Cast<DestinyType>(ProvidedType) allows us to convert a provided type to another using the built-in reflection system of UE
-	PlayerPawn = Cast<APawnTank>(UGameplayStatics::GetPlayerPawn(this, 0));
+	// "PawnBase" would play its own death particle on top of the budgeted explosion, so the budget takes it over
+	DestructionEffect = UEffectBudgetSubsystem::TakeOverDestructionEffect(this, APawnBase::StaticClass(), DestructionEffect);
 
 	/* Ensure the timer is created and bound to our CheckFireCondition() as soon as the game begins.
 	   GetTimerManager() is a kind of global timer manager for the game, so you can have multiple timers and this kinds of
@@ -34,97 +41,265 @@ void APawnTurret::BeginPlay()
 	   to bind and control this during gameplay. */
 	// This means that whenever the fire condition is met, the Turret will fire every X amount of seconds based on its fire rate 
 	GetWorld()->GetTimerManager().SetTimer(FireRateTimerHandle, this, &APawnTurret::CheckFireCondition, FireRate, true);
+
+	SpawnPointRestRotation = projectileSpawnPoint->GetRelativeRotation().Quaternion();
+
+	// Instead of each Turret looking at where the player's Tank is now, the Turret Aim Subsystem leads the Tank
+	// for every Turret in range at once, so the projectiles meet the Tank where it's going to be
+	UTurretAimSubsystem* AimSubsystem = GetWorld()->GetSubsystem<UTurretAimSubsystem>();
+	if (AimSubsystem)
+	{
+		AimSubsystem->RegisterTurret(this);
+	}
 }
 ////////////////////////////////////////////////////////////////////////
 
-/////////////		Called every frame		/////////////
-void APawnTurret::Tick(float DeltaTime)
+////////		Sets the settings read from a Turret placement table		////////
+void APawnTurret::ApplyPlacement(const FTurretPlacementRecord& Record, TArrayView<const TSubclassOf<APickUpBase>> InPickUpClass)
 {
-	Super::Tick(DeltaTime);
+	// Called between SpawnActorDeferred() and FinishSpawning(), so BeginPlay() already sets the fire timer with this FireRate
+	FireRange = Record.FireRange;
+	FireRate = Record.FireRate;
+	PickUpClass.Reset(InPickUpClass.Num());
+	PickUpClass.Append(InPickUpClass.GetData(), InPickUpClass.Num());
 
-	if (!PlayerPawn || ReturnDistanceToPlayer() > FireRange)
+	AimProjectileSpeed = Record.AimProjectileSpeed;
+	AimTurnRate = Record.AimTurnRate;
+	MinAimPitch = Record.MinAimPitch;
+	MaxAimPitch = Record.MaxAimPitch;
+
+	// The projectile and Pick Up settings themselves can't differ from the class defaults in a baked Turret (the commandlet refuses it)
+	bUseBallisticProjectiles = EnumHasAnyFlags(Record.Flags, ETurretPlacementFlags::UseBallisticProjectiles);
+	bUseLightweightPickUps = EnumHasAnyFlags(Record.Flags, ETurretPlacementFlags::UseLightweightPickUps);
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Baked Turrets only exist in the editor		////////
+bool APawnTurret::IsEditorOnly() const
+{
+#if WITH_EDITORONLY_DATA
+	if (bBakeIntoPlacementTable)
 	{
-		// If there isn't any player Tank or he's out of the Turret's firing range, exit this function
-		return;
+		// The cooker leaves editor-only Actors out of the cooked map, the placement table spawns them instead
+		return true;
 	}
-	else
+#endif
+
+	return Super::IsEditorOnly();
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Called when the Turret is removed from the world		////////
+void APawnTurret::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UTurretAimSubsystem* AimSubsystem = GetWorld()->GetSubsystem<UTurretAimSubsystem>();
+	if (AimSubsystem)
 	{
-		// Call RotateTurret() from parent class "PawnBase.h" to get a "look-at" rotation to the Player's Tank when it's in range
-		RotateTurret(PlayerPawn->GetActorLocation());
+		AimSubsystem->UnregisterTurret(this);
 	}
+
+	Super::EndPlay(EndPlayReason);
 }
 ////////////////////////////////////////////////////////////////////////
 
 //////	Checking that the desired conditions have been met to allow the firing functionality to be called on the parent class	//////
 void APawnTurret::CheckFireCondition()
 {
-	if(!PlayerPawn || !PlayerPawn->GetIsPlayerAlive())
+	FLoadTestScope LoadTestScope(ELoadTestSystem::Turrets);
+	CRAZYTANK_HITCH_SCOPE("Turret.CheckFireCondition");
+
+	// Any live Tank can be targeted, not only player 0's: the bots of the server load test are attacked like players
+	UTurretAimSubsystem* AimSubsystem = GetWorld()->GetSubsystem<UTurretAimSubsystem>();
+	TargetTank = AimSubsystem ? AimSubsystem->FindClosestTarget(GetActorLocation(), FireRange) : Cast<APawnTank>(UGameplayStatics::GetPlayerPawn(this, 0));
+
+	if(!TargetTank || !TargetTank->GetIsPlayerAlive())
 	{
-		// If there isn't any player Tank or it's dead, stop the tick and exit the function
-		SetActorTickEnabled(false);
+		// If there isn't any Tank in range or it's dead, exit the function (the Turret Aim Subsystem skips Turrets without a target)
+		TargetTank = nullptr;
 		return;
 	}
 
-	if(ReturnDistanceToPlayer() <= FireRange)
+	if(ReturnDistanceToTarget() <= FireRange)
 	{ 
-		// If the player's Tank is in range,
+		// If the target Tank is in range,
 		// call the firing logic from parent class "PawnBase"
 		Fire();
 	}
 }
 ////////////////////////////////////////////////////////////////////////
 
-////////		Calculate the distance to the player's Tank to see if it's in firing range		////////
-float APawnTurret::ReturnDistanceToPlayer()
+////////		Fires a projectile Actor through the "PawnBase" parent class, or a simulated one		////////
+void APawnTurret::Fire()
 {
-	if (!PlayerPawn)
+	CRAZYTANK_HITCH_SCOPE("Turret.Fire");
+
+	UBallisticProjectileSubsystem* BallisticSubsystem = GetWorld()->GetSubsystem<UBallisticProjectileSubsystem>();
+	if (!bUseBallisticProjectiles || !BallisticSubsystem || !BallisticSubsystem->IsSimulationAllowed())
+	{
+		// Spawn a projectile Actor using the "PawnBase" parent class
+		Super::Fire();
+		return;
+	}
+
+	if (BallisticProjectileType == INDEX_NONE)
 	{
-		// If there isn't any player Tank, return 0
+		BallisticProjectileType = BallisticSubsystem->RegisterProjectileType(BallisticProjectile);
+	}
+
+	// The projectile is only a few entries in the subsystem's arrays, no Actor or components are spawned
+	BallisticSubsystem->FireProjectile
+	(
+		BallisticProjectileType,
+		projectileSpawnPoint->GetComponentLocation(),
+		projectileSpawnPoint->GetComponentRotation(),
+		this
+	);
+}
+//////////////////////////////////////////////////////////////////////////////////////
+
+////////		Speed of whichever projectile this Turret fires (simulated or Actor)		////////
+float APawnTurret::GetAimProjectileSpeed() const
+{
+	const UBallisticProjectileSubsystem* BallisticSubsystem = GetWorld()->GetSubsystem<UBallisticProjectileSubsystem>();
+	return bUseBallisticProjectiles && BallisticSubsystem && BallisticSubsystem->IsSimulationAllowed() ? BallisticProjectile.Speed : AimProjectileSpeed;
+}
+//////////////////////////////////////////////////////////////////////////////////////
+
+////////		Turns the turret's head to the given yaw, and its projectile spawn point to the given pitch		////////
+void APawnTurret::ApplyAim(float Yaw, float Pitch)
+{
+	// Like "PawnBase" RotateTurret(), the head only turns around the yaw/up vector
+	TurretMesh->SetWorldRotation(FRotator(0.0f, Yaw, 0.0f));
+
+	// The pitch only tilts where the projectiles leave from (around its own authored axes), so they reach a target above or below the Turret
+	projectileSpawnPoint->SetRelativeRotation(SpawnPointRestRotation * FRotator(Pitch, 0.0f, 0.0f).Quaternion());
+}
+//////////////////////////////////////////////////////////////////////////////////////
+
+////////		Calculate the distance to the target Tank to see if it's in firing range		////////
+float APawnTurret::ReturnDistanceToTarget()
+{
+	if (!TargetTank)
+	{
+		// If there isn't any target Tank, return 0
 		return 0.0f;
 	}
 
 	//Dist() Returns the distance between two FVectors as a float value
-	return FVector::Dist(PlayerPawn->GetActorLocation(), GetActorLocation());
+	return FVector::Dist(TargetTank->GetActorLocation(), GetActorLocation());
 }
 //////////////////////////////////////////////////////////////////////////////////////
 
 ////////		Manages this pawn's behaviour when it's destroyed		////////
 void APawnTurret::HandleDestruction()
 {
+	CRAZYTANK_HITCH_SCOPE("Turret.HandleDestruction");
+
 	// Call parent "PawnBase" class's HandleDestruction() to play effects
 	Super::HandleDestruction();
 
+	// The explosion is played here instead of in "PawnBase", so it goes through the effect budget
+	// (far away, off screen or too many explosions at once are skipped)
+	UEffectBudgetSubsystem::SpawnOneShotInWorld(GetWorld(), EEffectCategory::Destruction, DestructionEffect, GetActorLocation(), GetActorRotation());
+
 	/*
 
 		Overriding logic in this child class
 	
 	*/
 
+	// Take the Turret out of the fight right away: hide it, stop its collision, its aiming and its firing timer
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+	GetWorld()->GetTimerManager().ClearTimer(FireRateTimerHandle);
+
+	UTurretAimSubsystem* AimSubsystem = GetWorld()->GetSubsystem<UTurretAimSubsystem>();
+	if (AimSubsystem)
+	{
+		AimSubsystem->UnregisterTurret(this);
+	}
+
+	// Spawning the Pick Up and destroying the Turret is left to the Destruction Subsystem, which spreads that work
+	// across frames so a chain of explosions destroying lots of Turrets doesn't do it all in the same frame
+	UDestructionSubsystem* DestructionSubsystem = GetWorld()->GetSubsystem<UDestructionSubsystem>();
+	if (DestructionSubsystem)
+	{
+		DestructionSubsystem->QueueDestruction(this, FSimpleDelegate::CreateUObject(this, &APawnTurret::FinishDestruction));
+	}
+	else
+	{
+		FinishDestruction();
+	}
+}
+//////////////////////////////////////////////////////////////////////////////////////
+
+////////		Drops a random Pick Up through the Pick Up Subsystem		////////
+bool APawnTurret::DropLightweightPickUp(const FVector& Location)
+{
+	// The Pick Up Subsystem isn't replicated, clients would neither see nor collect its Pick Ups
+	UPickUpSubsystem* PickUpSubsystem = GetWorld()->GetSubsystem<UPickUpSubsystem>();
+	if (!PickUpSubsystem || LightweightPickUps.Num() == 0 || GetNetMode() != NM_Standalone)
+	{
+		return false;
+	}
+
+	if (LightweightPickUpTypes.Num() != LightweightPickUps.Num())
+	{
+		LightweightPickUpTypes.Reset();
+		for (const FPickUpParams& Params : LightweightPickUps)
+		{
+			LightweightPickUpTypes.Add(PickUpSubsystem->RegisterPickUpType(Params));
+		}
+	}
+
+	int32 RandomIndex = FMath::RandRange(0, LightweightPickUpTypes.Num() - 1);
+	PickUpSubsystem->SpawnPickUp(LightweightPickUpTypes[RandomIndex], Location);
+	return true;
+}
+//////////////////////////////////////////////////////////////////////////////////////
+
+////////		Spawns the Pick Up (if any) and destroys this Turret		////////
+void APawnTurret::FinishDestruction()
+{
+	CRAZYTANK_HITCH_SCOPE("Turret.FinishDestruction");
+
+	// The explosion is resolved here rather than in HandleDestruction(), so Turrets destroyed by the explosion
+	// of another one explode in a later frame instead of chaining all in the same one
+	UDestructionSubsystem* DestructionSubsystem = GetWorld()->GetSubsystem<UDestructionSubsystem>();
+	if (DestructionSubsystem && ExplosionRadius > 0.0f)
+	{
+		DestructionSubsystem->ApplyRadialDamage(GetActorLocation(), ExplosionRadius, ExplosionDamage, 0.0f, this, GetInstigatorController(), nullptr);
+	}
+
 	// Get a random number for enabling the spawning of Pick Ups when this Turret is going to be destroyed
 	int SpawnPickUp = FMath::RandRange(0, 10);
 	if (SpawnPickUp >= 5)
 	{
-		if (PickUpClass.Num() != 0)
+		if (bUseLightweightPickUps && DropLightweightPickUp(RootComponent->GetComponentLocation()))
+		{
+			// The Pick Up is only an entry in the Pick Up Subsystem, no Actor or overlap component is spawned
+		}
+		else if (PickUpClass.Num() != 0)
 		{
 			// If the random number is greater than some value and the Turret has any Pick Up class assigned
 			// Spawn a random Pick Up at the same location of this Turret before it gets destroyed
 			int32 RandomIndex = FMath::RandRange(0, PickUpClass.Num() - 1);
 			FVector SpawnLocation = RootComponent->GetComponentLocation();
-			APickUpBase* TempPickUp = GetWorld()->SpawnActor<APickUpBase>(PickUpClass[RandomIndex], SpawnLocation, FRotator::ZeroRotator);
+			GetWorld()->SpawnActor<APickUpBase>(PickUpClass[RandomIndex], SpawnLocation, FRotator::ZeroRotator);
 		}
 		else
 		{
+			// The Turret is already hidden and without collision, so it's destroyed anyway
 			UE_LOG
 			(
 				LogTemp,
 				Error,
 				TEXT("'PickUpClass' component on Actor %s expects it to have a PickUp type set but there isn't any"),
-				*GetOwner()->GetName()
+				*GetName()
 			);
-			return;
 		}
 	}
 
 	Destroy();
 }
-//////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
+//////////////////////////////////////////////////////////////////////////////////////
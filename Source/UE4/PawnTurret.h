@@ -10,6 +10,8 @@
 
 #include "CoreMinimal.h"
 #include "PawnBase.h"
+#include "BallisticProjectileSubsystem.h"
+#include "PickUpSubsystem.h"
 #include "PawnTurret.generated.h"
 
  /*
@@ -20,6 +22,7 @@
 
 class APawnTank;
 class APickUpBase;
+struct FTurretPlacementRecord;
 
 ////////////////////////////////////////////////////////////////////////////// 
 //
@@ -43,9 +46,58 @@ private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat", meta = (AllowPrivateAccess = "true"))
 	float FireRate = 2.0f; // If the player is in range, the Turret will fire every FireRate seconds
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat", meta = (AllowPrivateAccess = "true", ClampMin = "0"))
+	float ExplosionRadius = 0.0f; // Actors this close are damaged when the Turret is destroyed (0 for no explosion damage)
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat", meta = (AllowPrivateAccess = "true"))
+	float ExplosionDamage = 30.0f; // Damage at the Turret's location, it goes down linearly to 0 at ExplosionRadius
+
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Pick-Up Type", meta = (AllowPrivateAccess = "true"))
 	TArray< TSubclassOf<APickUpBase> > PickUpClass; // The kind of Pick Up/s that the Turret will drop when destroyed
 
+	// When true, the dropped Pick Up is an entry in the Pick Up Subsystem instead of a Pick Up Actor with its own overlap.
+	// Those entries aren't replicated, so this is only used in standalone games: networked games drop the Pick Up Actors
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Pick-Up Type", meta = (AllowPrivateAccess = "true"))
+	bool bUseLightweightPickUps = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Pick-Up Type", meta = (AllowPrivateAccess = "true", EditCondition = "bUseLightweightPickUps"))
+	TArray<FPickUpParams> LightweightPickUps; // The kind of Pick Up/s dropped through the Pick Up Subsystem, one is chosen at random
+
+	TArray<int32> LightweightPickUpTypes; // Index of every LightweightPickUps entry in the Pick Up Subsystem
+
+	// When true, projectiles are simulated by the Ballistic Projectile Subsystem instead of spawning projectile Actors.
+	// They aren't replicated, so networked games still spawn the projectile Actors
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile Type", meta = (AllowPrivateAccess = "true"))
+	bool bUseBallisticProjectiles = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile Type", meta = (AllowPrivateAccess = "true", EditCondition = "bUseBallisticProjectiles"))
+	FBallisticProjectileParams BallisticProjectile; // Projectile settings used by the Ballistic Projectile Subsystem
+
+	int32 BallisticProjectileType = INDEX_NONE; // Index of BallisticProjectile in the Ballistic Projectile Subsystem
+
+	// Explosion played through the effect budget when the Turret is destroyed (when empty, the "PawnBase" death particle is played through it instead)
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Effects", meta = (AllowPrivateAccess = "true"))
+	UParticleSystem* DestructionEffect = nullptr;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Aim", meta = (AllowPrivateAccess = "true"))
+	float AimProjectileSpeed = 1300.0f; // Speed of the projectile Actors fired by this Turret, used for leading the target
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Aim", meta = (AllowPrivateAccess = "true"))
+	float AimTurnRate = 180.0f; // How fast (degrees per second) the Turret can turn towards its aim
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Aim", meta = (AllowPrivateAccess = "true"))
+	float MinAimPitch = -10.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Aim", meta = (AllowPrivateAccess = "true"))
+	float MaxAimPitch = 30.0f;
+
+#if WITH_EDITORONLY_DATA
+	// When true, this Turret is cooked into its map's Turret placement table and stripped from the cooked map,
+	// a Turret Placement Spawner then spawns it when the player gets close
+	UPROPERTY(EditAnywhere, Category = "Placement")
+	bool bBakeIntoPlacementTable = false;
+#endif
+
 	// Timers allow us to trigger events based on elapsed time in the form of creating asynchronous
 	// callbacks to specific function pointers.
 	// This Timer is for firing every X amount of seconds based on this fire rate
@@ -53,7 +105,10 @@ private:
 	// FTimerHandle allows us to bind and unbind our timer (control when to start or stop them)
 	FTimerHandle FireRateTimerHandle;
 
-	APawnTank* PlayerPawn = nullptr; // Reference to the Player's Tank
+	FQuat SpawnPointRestRotation = FQuat::Identity; // Relative rotation the projectile spawn point was authored with, the aim's pitch is added to it
+
+	UPROPERTY()
+	APawnTank* TargetTank = nullptr; // The closest live Tank in range (the player's, or a bot's), chosen every time the Turret checks its fire condition
 	
 	/*
 		METHODS
@@ -61,7 +116,25 @@ private:
 
 	void CheckFireCondition(); // Checking that desired conditions have been met to allow the firing functionality to be called on the parent class
 	
-	float ReturnDistanceToPlayer(); // Calculate the distance to the player's Tank to see if it's in firing range
+	float ReturnDistanceToTarget(); // Calculate the distance to the target Tank to see if it's in firing range
+
+	virtual void Fire() override; // Fires a projectile Actor through the "PawnBase" parent class, or a simulated one
+
+	float GetAimProjectileSpeed() const; // Speed of whichever projectile this Turret fires (simulated or Actor)
+
+	// Turns the turret's head to the given yaw, and its projectile spawn point to the given pitch
+	void ApplyAim(float Yaw, float Pitch); // Called by the Turret Aim Subsystem after solving where to aim
+
+	// The Turret Aim Subsystem reads the aim settings and the target Tank, and applies the solved aim
+	friend class UTurretAimSubsystem;
+
+	// The cooking commandlet reads the Turret's settings into its map's placement table
+	friend class UCookTurretPlacementCommandlet;
+
+	bool DropLightweightPickUp(const FVector& Location); // Drops a random Pick Up through the Pick Up Subsystem, false if it can't
+
+	// Spawns the Pick Up (if any) and destroys this Turret
+	void FinishDestruction(); // Called by the Destruction Subsystem in a later frame, so chain explosions don't do all this work at once
 
 public:
 
@@ -72,11 +145,13 @@ public:
 	// Sets default values for this pawn's properties
 	APawnTurret();
 
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
-
 	virtual void HandleDestruction() override; // Manages this pawn's behaviour when it's destroyed
 
+	// Sets the settings read from a Turret placement table, called between SpawnActorDeferred() and FinishSpawning()
+	void ApplyPlacement(const FTurretPlacementRecord& Record, TArrayView<const TSubclassOf<APickUpBase>> InPickUpClass);
+
+	virtual bool IsEditorOnly() const override; // Baked Turrets only exist in the editor, the cooked map loads them from the placement table
+
 protected:
 
 	/*
@@ -86,4 +161,6 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override; // Called when the Turret is removed from the world
+
 };
@@ -0,0 +1,291 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "PickUpSubsystem.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "Sound/SoundBase.h"
+#include "PawnTank.h"
+#include "LoadTestStats.h"
+#include "HitchCapture.h"
+
+/*
+
+	FPickUpParams
+
+*/
+
+bool FPickUpParams::operator==(const FPickUpParams& Other) const
+{
+	return AmmoType == Other.AmmoType
+		&& Amount == Other.Amount
+		&& Mesh == Other.Mesh
+		&& MeshScale == Other.MeshScale
+		&& CollectSound == Other.CollectSound;
+}
+
+/*
+
+	UPickUpSubsystem
+
+*/
+
+////////		Returns the index to drop this kind of Pick Up with, equal kinds share the same index		////////
+int32 UPickUpSubsystem::RegisterPickUpType(const FPickUpParams& Params)
+{
+	// Every Turret registers its Pick Ups, but most of them share the same settings
+	int32 TypeIndex = PickUpTypes.IndexOfByKey(Params);
+	if (TypeIndex != INDEX_NONE)
+	{
+		return TypeIndex;
+	}
+
+	TypeIndex = PickUpTypes.Add(Params);
+	TypeVisuals.AddVisual(GetWorld(), Params.Mesh);
+
+	return TypeIndex;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Drops a Pick Up of a registered kind		////////
+void UPickUpSubsystem::SpawnPickUp(int32 TypeIndex, const FVector& Location)
+{
+	if (!PickUpTypes.IsValidIndex(TypeIndex))
+	{
+		return;
+	}
+
+	Positions.Add(Location);
+	TypeIndices.Add(TypeIndex);
+	IsCollected.Add(false);
+
+	bVisualsDirty = true;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Lets a Tank collect Pick Ups		////////
+void UPickUpSubsystem::RegisterCollector(APawnTank* Tank)
+{
+	if (!Tank || Collectors.ContainsByPredicate([Tank](const FPickUpCollector& Collector) { return Collector.Tank == Tank; }))
+	{
+		return;
+	}
+
+	FPickUpCollector Collector;
+	Collector.Tank = Tank;
+	FMemory::Memzero(Collector.CollectedAmmo);
+	Collectors.Add(Collector);
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Stops a Tank from collecting		////////
+void UPickUpSubsystem::UnregisterCollector(APawnTank* Tank)
+{
+	Collectors.RemoveAllSwap([Tank](const FPickUpCollector& Collector) { return Collector.Tank == Tank; });
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Collects the Pick Ups around every Tank		////////
+void UPickUpSubsystem::Tick(float DeltaTime)
+{
+	FLoadTestScope LoadTestScope(ELoadTestSystem::PickUps);
+	CRAZYTANK_HITCH_SCOPE("PickUps.Tick");
+
+	CollectPickUps(DeltaTime);
+	GiveCollectedAmmo();
+	RemoveCollectedPickUps();
+
+	if (bVisualsDirty)
+	{
+		UpdateVisuals();
+		bVisualsDirty = false;
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Runs every Tank's radius query, pulling and collecting the Pick Ups around it		////////
+void UPickUpSubsystem::CollectPickUps(float DeltaTime)
+{
+	const bool bPlaySounds = ShouldDrawEffects();
+
+	for (FPickUpCollector& Collector : Collectors)
+	{
+		APawnTank* Tank = Collector.Tank.Get();
+		if (!Tank || !Tank->GetIsPlayerAlive())
+		{
+			continue;
+		}
+
+		const FVector TankLocation = Tank->GetActorLocation();
+		const float CollectRadiusSquared = FMath::Square(Tank->PickUpCollectRadius);
+		const float MagnetRadiusSquared = FMath::Square(FMath::Max(Tank->PickUpMagnetRadius, Tank->PickUpCollectRadius));
+		const float MagnetStep = Tank->PickUpMagnetSpeed * DeltaTime;
+
+		// One pass over contiguous positions per Tank, there's no physics body per Pick Up to keep in the broadphase
+		for (int32 Index = 0; Index < Positions.Num(); Index++)
+		{
+			if (IsCollected[Index])
+			{
+				continue;
+			}
+
+			FVector& Position = Positions[Index];
+			float DistSquared = FVector::DistSquared(Position, TankLocation);
+			if (DistSquared > MagnetRadiusSquared)
+			{
+				continue;
+			}
+
+			if (DistSquared > CollectRadiusSquared && MagnetStep > 0.0f)
+			{
+				// Pulled towards the Tank, it's collected in this frame if the pull gets it close enough
+				Position = FMath::VInterpConstantTo(Position, TankLocation, 1.0f, MagnetStep);
+				DistSquared = FVector::DistSquared(Position, TankLocation);
+				bVisualsDirty = true;
+			}
+
+			if (DistSquared <= CollectRadiusSquared)
+			{
+				const FPickUpParams& Params = PickUpTypes[TypeIndices[Index]];
+				if (Params.AmmoType >= 0 && Params.AmmoType < NumAmmoTypes)
+				{
+					Collector.CollectedAmmo[Params.AmmoType] += Params.Amount;
+				}
+
+				if (bPlaySounds && Params.CollectSound)
+				{
+					UGameplayStatics::PlaySoundAtLocation(this, Params.CollectSound, Position);
+				}
+
+				IsCollected[Index] = true;
+				bVisualsDirty = true;
+			}
+		}
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		One AddAmmo() per Tank and ammo type		////////
+void UPickUpSubsystem::GiveCollectedAmmo()
+{
+	for (FPickUpCollector& Collector : Collectors)
+	{
+		APawnTank* Tank = Collector.Tank.Get();
+		for (int32 AmmoType = 0; AmmoType < NumAmmoTypes; AmmoType++)
+		{
+			// However many Pick Ups were collected this frame, the Tank (and its HUD) is only notified once per ammo type
+			if (Tank && Collector.CollectedAmmo[AmmoType] != 0)
+			{
+				Tank->AddAmmo(AmmoType, Collector.CollectedAmmo[AmmoType]);
+			}
+			Collector.CollectedAmmo[AmmoType] = 0;
+		}
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+void UPickUpSubsystem::RemoveCollectedPickUps()
+{
+	// Going backwards, so swapping the last Pick Up into a removed slot never skips one
+	for (int32 Index = Positions.Num() - 1; Index >= 0; Index--)
+	{
+		if (IsCollected[Index])
+		{
+			Positions.RemoveAtSwap(Index, 1, false);
+			TypeIndices.RemoveAtSwap(Index, 1, false);
+			IsCollected.RemoveAtSwap(Index, 1, false);
+		}
+	}
+}
+
+////////		Finds the closest Pick Up within MaxDistance		////////
+bool UPickUpSubsystem::FindClosestPickUp(const FVector& Location, float MaxDistance, int32 AmmoType, FVector& OutLocation) const
+{
+	float ClosestDistSquared = FMath::Square(MaxDistance);
+	bool bFound = false;
+
+	for (int32 Index = 0; Index < Positions.Num(); Index++)
+	{
+		if (AmmoType != INDEX_NONE && PickUpTypes[TypeIndices[Index]].AmmoType != AmmoType)
+		{
+			continue;
+		}
+
+		float DistSquared = FVector::DistSquared(Location, Positions[Index]);
+		if (DistSquared < ClosestDistSquared)
+		{
+			ClosestDistSquared = DistSquared;
+			OutLocation = Positions[Index];
+			bFound = true;
+		}
+	}
+
+	return bFound;
+}
+////////////////////////////////////////////////////////////////////////
+
+int32 UPickUpSubsystem::GetPickUpCount() const
+{
+	return Positions.Num();
+}
+
+////////		Moves the instanced meshes to where the Pick Ups are		////////
+void UPickUpSubsystem::UpdateVisuals()
+{
+	for (int32 TypeIndex = 0; TypeIndex < PickUpTypes.Num(); TypeIndex++)
+	{
+		if (!TypeVisuals.HasVisual(TypeIndex))
+		{
+			continue;
+		}
+
+		const FPickUpParams& Params = PickUpTypes[TypeIndex];
+
+		TArray<FTransform>& InstanceTransforms = TypeVisuals.ResetInstanceTransforms();
+		for (int32 Index = 0; Index < Positions.Num(); Index++)
+		{
+			if (TypeIndices[Index] == TypeIndex)
+			{
+				InstanceTransforms.Emplace(FQuat::Identity, Positions[Index], Params.MeshScale);
+			}
+		}
+
+		TypeVisuals.UpdateVisual(TypeIndex);
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+bool UPickUpSubsystem::ShouldDrawEffects() const
+{
+	UWorld* World = GetWorld();
+	return World && World->GetNetMode() != NM_DedicatedServer;
+}
+
+////////		Called when the world is torn down		////////
+void UPickUpSubsystem::Deinitialize()
+{
+	Positions.Empty();
+	TypeIndices.Empty();
+	IsCollected.Empty();
+	Collectors.Empty();
+	TypeVisuals.Reset();
+
+	Super::Deinitialize();
+}
+////////////////////////////////////////////////////////////////////////
+
+bool UPickUpSubsystem::HasWorkToTick() const
+{
+	// The visuals still need one last update after the last Pick Up was collected
+	return GetPickUpCount() > 0 || bVisualsDirty;
+}
+
+TStatId UPickUpSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPickUpSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,159 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CrazyTankTickableWorldSubsystem.h"
+#include "InstancedVisualPool.h"
+#include "PickUpSubsystem.generated.h"
+
+/*
+
+	Engine classes
+
+*/
+
+class USoundBase;
+class UStaticMesh;
+
+/*
+
+	Crazy Tank classes
+
+*/
+
+class APawnTank;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// Everything needed to draw and collect one kind of ammo Pick Up
+//
+//////////////////////////////////////////////////////////////////////////////
+USTRUCT(BlueprintType)
+struct CRAZYTANK_API FPickUpParams
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Ammo", meta = (ClampMin = "0", ClampMax = "1"))
+	int32 AmmoType = 0; // Same as APawnTank::AddAmmo(): 0 for regular projectiles, 1 for homing projectiles
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Ammo")
+	int32 Amount = 2;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Effects")
+	UStaticMesh* Mesh = nullptr; // Drawn with one instanced mesh component for every Pick Up of this kind
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Effects")
+	FVector MeshScale = FVector::OneVector;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Effects")
+	USoundBase* CollectSound = nullptr;
+
+	bool operator==(const FPickUpParams& Other) const;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This class keeps the ammo Pick Ups dropped by Turrets as plain entries instead of Actors with overlap components:
+// once per frame, every Tank looks for the Pick Ups around it (pulling the close ones in with its magnet),
+// and everything a Tank collected in that frame is added to its ammo with one AddAmmo() call per ammo type.
+// Nothing here is replicated, so only standalone games drop Pick Ups through it
+//
+//////////////////////////////////////////////////////////////////////////////
+UCLASS()
+class CRAZYTANK_API UPickUpSubsystem : public UCrazyTankTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	static const int32 NumAmmoTypes = 2; // Ammo types handled by APawnTank::AddAmmo()
+
+	UPROPERTY()
+	TArray<FPickUpParams> PickUpTypes; // Every kind of Pick Up registered by the Turrets
+
+	UPROPERTY()
+	FInstancedVisualPool TypeVisuals; // One instanced mesh per Pick Up kind
+
+	// Pick Ups lying around, one entry per Pick Up at the same index in every array
+	TArray<FVector> Positions;
+
+	TArray<int32> TypeIndices;
+
+	TArray<bool> IsCollected;
+
+	// A Tank collecting Pick Ups, with what it collected this frame
+	struct FPickUpCollector
+	{
+		TWeakObjectPtr<APawnTank> Tank;
+
+		int32 CollectedAmmo[NumAmmoTypes];
+	};
+
+	TArray<FPickUpCollector> Collectors;
+
+	bool bVisualsDirty = false; // Pick Ups were added, collected or pulled since the instanced meshes were last updated
+
+	/*
+		METHODS
+	*/
+
+	void CollectPickUps(float DeltaTime); // Runs every Tank's radius query, pulling and collecting the Pick Ups around it
+
+	void GiveCollectedAmmo(); // One AddAmmo() per Tank and ammo type, so the HUD is updated once however many were collected
+
+	void RemoveCollectedPickUps();
+
+	void UpdateVisuals(); // Moves the instanced meshes to where the Pick Ups are
+
+	bool ShouldDrawEffects() const; // Dedicated servers collect Pick Ups, but don't draw anything
+
+public:
+
+	/*
+		METHODS
+	*/
+
+	// Returns the index to drop this kind of Pick Up with, equal kinds share the same index
+	int32 RegisterPickUpType(const FPickUpParams& Params);
+
+	void SpawnPickUp(int32 TypeIndex, const FVector& Location); // Drops a Pick Up of a registered kind
+
+	void RegisterCollector(APawnTank* Tank); // Lets a Tank collect Pick Ups (called when it begins play)
+
+	void UnregisterCollector(APawnTank* Tank); // Stops a Tank from collecting (destroyed or removed from the world)
+
+	// Finds the closest Pick Up within MaxDistance, optionally only of one ammo type (INDEX_NONE for any)
+	bool FindClosestPickUp(const FVector& Location, float MaxDistance, int32 AmmoType, FVector& OutLocation) const;
+
+	int32 GetPickUpCount() const; // How many Pick Ups are lying around right now
+
+	virtual void Deinitialize() override; // Called when the world is torn down
+
+	/*
+		FTickableGameObject interface
+	*/
+
+	virtual void Tick(float DeltaTime) override; // Collects the Pick Ups around every Tank
+
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/*
+		METHODS
+	*/
+
+	virtual bool HasWorkToTick() const override; // While Pick Ups are lying around (and once more to hide the last one)
+
+};
@@ -0,0 +1,215 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "TankBotController.h"
+#include "EngineUtils.h"
+#include "CrazyTank/Actors/PickUpBase.h"
+#include "PawnTank.h"
+#include "PawnTurret.h"
+#include "LoadTestStats.h"
+#include "PickUpSubsystem.h"
+#include "HitchCapture.h"
+
+////////		Sets default values for this controller's properties	////////
+ATankBotController::ATankBotController()
+{
+	PrimaryActorTick.bCanEverTick = true;
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Called when this controller takes control of a Tank		////////
+void ATankBotController::OnPossess(APawn* InPawn)
+{
+	Super::OnPossess(InPawn);
+
+	Tank = Cast<APawnTank>(InPawn);
+	if (!Tank)
+	{
+		UE_LOG(LogTemp, Error, TEXT("TankBotController %s can only possess Tanks"), *GetName());
+		return;
+	}
+
+	// The Tank reads its input in its own Tick, so the bot must always write it before that
+	Tank->AddTickPrerequisiteActor(this);
+
+	HomeLocation = Tank->GetActorLocation();
+	PickNewDestination();
+
+	// Don't let every bot spawned in the same frame shoot and search in the same frame too
+	FireCooldown = FMath::FRandRange(0.0f, FireInterval);
+	HomingCooldown = FMath::FRandRange(0.0f, HomingInterval);
+	RetargetCooldown = FMath::FRandRange(0.0f, RetargetInterval);
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Called when this controller releases its Tank		////////
+void ATankBotController::OnUnPossess()
+{
+	if (Tank)
+	{
+		Tank->RemoveTickPrerequisiteActor(this);
+		Tank = nullptr;
+	}
+
+	Super::OnUnPossess();
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Called every frame		////////
+void ATankBotController::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	FLoadTestScope LoadTestScope(ELoadTestSystem::Bots);
+	CRAZYTANK_HITCH_SCOPE("Bot.Tick");
+
+	if (!Tank || !Tank->GetIsPlayerAlive())
+	{
+		return;
+	}
+
+	RetargetCooldown -= DeltaTime;
+	if (RetargetCooldown <= 0.0f)
+	{
+		RetargetCooldown = RetargetInterval;
+		FindTargets();
+	}
+
+	FVector TankLocation = Tank->GetActorLocation();
+
+	// Drive to the ammo pick up if there's one, if not wander around
+	FVector DriveTo = bHasAmmoPickUp ? AmmoPickUpLocation : Destination;
+	FVector ToDestination = (DriveTo - TankLocation).GetSafeNormal2D();
+	if (FVector::DistSquared2D(TankLocation, DriveTo) < FMath::Square(300.0f))
+	{
+		// Reached: the pick up has been collected (or someone else got it first), or it's time to wander somewhere else
+		if (bHasAmmoPickUp)
+		{
+			bHasAmmoPickUp = false;
+		}
+		else
+		{
+			PickNewDestination();
+		}
+	}
+
+	float MoveValue = 1.0f;
+	float TurnValue = CalculateTurnInput(Tank->GetBodyForwardVector(), ToDestination);
+
+	// Keep the turret on the Turret being attacked, or looking where the Tank drives to
+	FVector AimAt = Target.IsValid() ? Target->GetActorLocation() : DriveTo;
+	FVector ToAim = (AimAt - TankLocation).GetSafeNormal2D();
+	float TurretValue = CalculateTurnInput(Tank->GetAimForwardVector(), ToAim);
+
+	Tank->SetBotInput(MoveValue, TurnValue, TurretValue);
+
+	FireCooldown -= DeltaTime;
+	HomingCooldown -= DeltaTime;
+
+	if (!Target.IsValid())
+	{
+		return;
+	}
+
+	// Only shoot when the turret is roughly aiming at the target
+	bool bIsAimed = FVector::DotProduct(Tank->GetAimForwardVector().GetSafeNormal2D(), ToAim) > 0.97f;
+	if (!bIsAimed)
+	{
+		return;
+	}
+
+	if (FireCooldown <= 0.0f && Tank->GetProjectileAmmo() > 0)
+	{
+		FireCooldown = FireInterval;
+		Tank->BotFire();
+	}
+
+	if (HomingCooldown <= 0.0f && Tank->GetHomingProjectileAmmo() > 0)
+	{
+		// Lock on whatever is in front of the turret and shoot the homing volley right away
+		HomingCooldown = HomingInterval;
+		Tank->BotTargetHomingProjectile();
+		Tank->BotFireHomingProjectile();
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Looks for the closest Turret in range and, when low on ammo, the closest ammo pick up		////////
+void ATankBotController::FindTargets()
+{
+	FVector TankLocation = Tank->GetActorLocation();
+
+	Target = nullptr;
+	float ClosestTargetDistSquared = FMath::Square(EngageRange);
+	for (TActorIterator<APawnTurret> It(GetWorld()); It; ++It)
+	{
+		if (It->IsHidden())
+		{
+			// Already destroyed and waiting in the Destruction Subsystem's queue
+			continue;
+		}
+
+		float DistSquared = FVector::DistSquared(TankLocation, It->GetActorLocation());
+		if (DistSquared < ClosestTargetDistSquared)
+		{
+			ClosestTargetDistSquared = DistSquared;
+			Target = *It;
+		}
+	}
+
+	bHasAmmoPickUp = false;
+	if (Tank->GetProjectileAmmo() > 0 && Tank->GetHomingProjectileAmmo() > 0)
+	{
+		return;
+	}
+
+	// Pick Ups dropped through the Pick Up Subsystem are only entries, only the ammo type that ran out is looked for
+	int32 WantedAmmoType = Tank->GetProjectileAmmo() > 0 ? 1 : (Tank->GetHomingProjectileAmmo() > 0 ? 0 : INDEX_NONE);
+	UPickUpSubsystem* PickUpSubsystem = GetWorld()->GetSubsystem<UPickUpSubsystem>();
+	if (PickUpSubsystem)
+	{
+		bHasAmmoPickUp = PickUpSubsystem->FindClosestPickUp(TankLocation, WanderRadius, WantedAmmoType, AmmoPickUpLocation);
+	}
+
+	// Pick Up Actors are still placed in maps (or dropped by Turrets not using the Pick Up Subsystem)
+	float ClosestPickUpDistSquared = bHasAmmoPickUp ? FVector::DistSquared(TankLocation, AmmoPickUpLocation) : FMath::Square(WanderRadius);
+	for (TActorIterator<APickUpBase> It(GetWorld()); It; ++It)
+	{
+		float DistSquared = FVector::DistSquared(TankLocation, It->GetActorLocation());
+		if (DistSquared < ClosestPickUpDistSquared)
+		{
+			ClosestPickUpDistSquared = DistSquared;
+			AmmoPickUpLocation = It->GetActorLocation();
+			bHasAmmoPickUp = true;
+		}
+	}
+}
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////		Chooses a random point in the wander area to drive to		////////
+void ATankBotController::PickNewDestination()
+{
+	FVector2D Offset = FMath::RandPointInCircle(WanderRadius);
+	Destination = HomeLocation + FVector(Offset.X, Offset.Y, 0.0f);
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Returns a value between -1 and 1 to turn from the current facing direction towards the desired one		////////
+float ATankBotController::CalculateTurnInput(const FVector& Forward, const FVector& DesiredDirection) const
+{
+	FVector FlatForward = Forward.GetSafeNormal2D();
+
+	// The sign of the cross product's Z tells which side the desired direction is on
+	float Side = FVector::CrossProduct(FlatForward, DesiredDirection).Z;
+	float Alignment = FVector::DotProduct(FlatForward, DesiredDirection);
+
+	// Turn at full speed when facing away, and slow down when almost aligned to avoid overshooting
+	float Angle = FMath::Atan2(Side, Alignment);
+	return FMath::Clamp(Angle / (PI * 0.25f), -1.0f, 1.0f);
+}
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
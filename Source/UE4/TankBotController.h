@@ -0,0 +1,104 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AIController.h"
+#include "TankBotController.generated.h"
+
+/*
+
+	Crazy Tank classes
+
+*/
+
+class APawnTank;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This class drives a Tank like a player would (driving, rotating the turret, firing, locking homing targets
+// and collecting ammo), so the dedicated server can be load tested without real clients
+//
+//////////////////////////////////////////////////////////////////////////////
+UCLASS()
+class CRAZYTANK_API ATankBotController : public AAIController
+{
+	GENERATED_BODY()
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot", meta = (AllowPrivateAccess = "true"))
+	float WanderRadius = 3000.0f; // How far from its spawn point the bot drives around
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot", meta = (AllowPrivateAccess = "true"))
+	float EngageRange = 2000.0f; // Turrets closer than this are aimed at and shot
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot", meta = (AllowPrivateAccess = "true"))
+	float FireInterval = 1.5f; // Seconds between two regular shots
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot", meta = (AllowPrivateAccess = "true"))
+	float HomingInterval = 6.0f; // Seconds between two homing lock-on and volley attempts
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot", meta = (AllowPrivateAccess = "true"))
+	float RetargetInterval = 1.0f; // Seconds between two searches for turrets and ammo pick ups
+
+	APawnTank* Tank = nullptr; // The possessed Tank
+
+	FVector HomeLocation = FVector::ZeroVector; // Where the Tank was possessed, the center of its wander area
+
+	FVector Destination = FVector::ZeroVector; // Where the bot is currently driving to
+
+	TWeakObjectPtr<AActor> Target; // Turret currently being attacked
+
+	bool bHasAmmoPickUp = false; // Whether the bot is driving to an ammo pick up because it's running out of ammo
+
+	FVector AmmoPickUpLocation = FVector::ZeroVector; // Where that pick up is (a Pick Up Actor or a Pick Up Subsystem entry)
+
+	float FireCooldown = 0.0f;
+
+	float HomingCooldown = 0.0f;
+
+	float RetargetCooldown = 0.0f;
+
+	/*
+		METHODS
+	*/
+
+	void FindTargets(); // Looks for the closest Turret in range and, when low on ammo, the closest ammo pick up
+
+	void PickNewDestination(); // Chooses a random point in the wander area to drive to
+
+	// Returns a value between -1 and 1 to turn from the current facing direction towards the desired one
+	float CalculateTurnInput(const FVector& Forward, const FVector& DesiredDirection) const;
+
+public:
+
+	/*
+		METHODS
+	*/
+
+	ATankBotController(); // Sets default values for this controller's properties
+
+	virtual void Tick(float DeltaTime) override; // Called every frame
+
+protected:
+
+	/*
+		METHODS
+	*/
+
+	virtual void OnPossess(APawn* InPawn) override; // Called when this controller takes control of a Tank
+
+	virtual void OnUnPossess() override; // Called when this controller releases its Tank
+
+};
@@ -0,0 +1,469 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "TankLoadTestGameMode.h"
+#include "Engine/World.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/CommandLine.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "PawnTank.h"
+#include "TankBotController.h"
+#include "HitchCapture.h"
+
+/*
+
+	FLoadTestStats
+
+*/
+
+bool FLoadTestStats::bIsRecording = false;
+
+double FLoadTestStats::SystemSeconds[(int32)ELoadTestSystem::Count] = {};
+
+const TCHAR* FLoadTestStats::GetSystemName(ELoadTestSystem System)
+{
+	switch (System)
+	{
+		case ELoadTestSystem::Tanks:
+			return TEXT("Tanks");
+
+		case ELoadTestSystem::Turrets:
+			return TEXT("Turrets");
+
+		case ELoadTestSystem::Bots:
+			return TEXT("Bots");
+
+		case ELoadTestSystem::Destruction:
+			return TEXT("Destruction");
+
+		case ELoadTestSystem::Projectiles:
+			return TEXT("Projectiles");
+
+		case ELoadTestSystem::PickUps:
+			return TEXT("PickUps");
+
+		default:
+			return TEXT("Unknown");
+	}
+}
+
+void FLoadTestStats::ResetFrame()
+{
+	for (double& Seconds : SystemSeconds)
+	{
+		Seconds = 0.0;
+	}
+}
+
+/*
+
+	ATankLoadTestGameMode
+
+*/
+
+////////		Sets default values for this game mode's properties	////////
+ATankLoadTestGameMode::ATankLoadTestGameMode()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	// There are no real players, every Tank in the world belongs to a bot
+	DefaultPawnClass = nullptr;
+	BotControllerClass = ATankBotController::StaticClass();
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Starts the load test once the world begins play		////////
+void ATankLoadTestGameMode::StartPlay()
+{
+	Super::StartPlay();
+
+	// The command line can override the Tank class and the amount of players to reach
+	FString TankClassPath;
+	if (FParse::Value(FCommandLine::Get(), TEXT("LoadTestTankClass="), TankClassPath))
+	{
+		BotTankClass = LoadClass<APawnTank>(nullptr, *TankClassPath);
+	}
+	FParse::Value(FCommandLine::Get(), TEXT("LoadTestMaxPlayers="), MaxPlayers);
+
+	if (!BotTankClass || !BotControllerClass)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Load test needs a Tank class (set BotTankClass or use -LoadTestTankClass=), exiting"));
+		FPlatformMisc::RequestExit(false);
+		return;
+	}
+
+	PlayerCountSteps.RemoveAll([this](int32 PlayerCount) { return PlayerCount <= 0 || PlayerCount > MaxPlayers; });
+	PlayerCountSteps.Sort();
+	if (PlayerCountSteps.Num() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Load test has no player count steps up to %d players, exiting"), MaxPlayers);
+		FPlatformMisc::RequestExit(false);
+		return;
+	}
+
+	// Frame timings are taken from the engine's delegates, so the idle time the server sleeps between ticks isn't counted
+	WorldTickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &ATankLoadTestGameMode::OnWorldTickStart);
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &ATankLoadTestGameMode::OnWorldPostActorTick);
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &ATankLoadTestGameMode::OnEndFrame);
+
+	BaselineMemory = FPlatformMemory::GetStats().UsedPhysical;
+
+	if (!StartStep(0))
+	{
+		FinishLoadTest();
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Called every frame		////////
+void ATankLoadTestGameMode::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (CurrentStep == INDEX_NONE)
+	{
+		return;
+	}
+
+	StepTime += DeltaSeconds;
+
+	if (!bIsSampling && StepTime >= WarmUpSeconds)
+	{
+		// The bots of this step had time to settle, start measuring
+		bIsSampling = true;
+		FLoadTestStats::bIsRecording = true;
+		MinLivePlayers = PlayerCountSteps[CurrentStep];
+	}
+
+	// Turrets kill bots, and a dead Tank is only hidden, so the dead ones are replaced to keep the step at its player count
+	if (GetLiveBotCount() < PlayerCountSteps[CurrentStep])
+	{
+		FillBots(PlayerCountSteps[CurrentStep]);
+	}
+
+	if (bIsSampling)
+	{
+		MinLivePlayers = FMath::Min(MinLivePlayers, GetLiveBotCount());
+	}
+
+	if (bIsSampling && StepTime >= WarmUpSeconds + SampleSeconds)
+	{
+		FinishStep();
+
+		if (CurrentStep + 1 >= PlayerCountSteps.Num() || !StartStep(CurrentStep + 1))
+		{
+			FinishLoadTest();
+		}
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Removes the frame timing delegates when the game mode goes away		////////
+void ATankLoadTestGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FWorldDelegates::OnWorldTickStart.Remove(WorldTickStartHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+
+	FLoadTestStats::bIsRecording = false;
+
+	Super::EndPlay(EndPlayReason);
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Writes the report of every finished step and closes the server		////////
+void ATankLoadTestGameMode::FinishLoadTest()
+{
+	CurrentStep = INDEX_NONE;
+	bIsSampling = false;
+	FLoadTestStats::bIsRecording = false;
+
+	WriteReport();
+	FPlatformMisc::RequestExit(false);
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Spawns the bots needed to reach the step's player count		////////
+bool ATankLoadTestGameMode::StartStep(int32 StepIndex)
+{
+	CurrentStep = StepIndex;
+	StepTime = 0.0f;
+	bIsSampling = false;
+	FLoadTestStats::bIsRecording = false;
+
+	FrameTickMs.Reset();
+	for (double& Seconds : SystemSecondsTotal)
+	{
+		Seconds = 0.0;
+	}
+	WorldTickSecondsTotal = 0.0;
+	EndOfFrameSecondsTotal = 0.0;
+
+	if (!FillBots(PlayerCountSteps[StepIndex]))
+	{
+		UE_LOG
+		(
+			LogTemp,
+			Error,
+			TEXT("Load test: step %d needs %d players but only %d bots could be spawned, ending the load test"),
+			StepIndex,
+			PlayerCountSteps[StepIndex],
+			GetLiveBotCount()
+		);
+		return false;
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Load test: step %d, %d players"), StepIndex, GetLiveBotCount());
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Replaces the dead bots and spawns new ones until PlayerCount bots are alive		////////
+bool ATankLoadTestGameMode::FillBots(int32 PlayerCount)
+{
+	RemoveDeadBots();
+
+	// Every failed attempt counts, so a map where bots can't be spawned ends the load test instead of hanging the server
+	int32 BotsToSpawn = PlayerCount - Bots.Num();
+	int32 AttemptsLeft = BotsToSpawn * FMath::Max(1, MaxSpawnAttemptsPerBot);
+	while (Bots.Num() < PlayerCount && AttemptsLeft > 0)
+	{
+		SpawnBot();
+		AttemptsLeft--;
+	}
+
+	return Bots.Num() >= PlayerCount;
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Destroys the bots whose Tank died (or went away)		////////
+void ATankLoadTestGameMode::RemoveDeadBots()
+{
+	Bots.RemoveAllSwap([](ATankBotController* Bot)
+	{
+		APawnTank* Tank = Bot ? Cast<APawnTank>(Bot->GetPawn()) : nullptr;
+		if (Tank && Tank->GetIsPlayerAlive())
+		{
+			return false;
+		}
+
+		// The dead Tank is left for a moment, so its queued explosion still goes through the Destruction Subsystem
+		if (Tank)
+		{
+			Tank->SetLifeSpan(1.0f);
+		}
+		if (Bot)
+		{
+			Bot->Destroy();
+		}
+		return true;
+	});
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Counts the bots whose Tank is still alive		////////
+int32 ATankLoadTestGameMode::GetLiveBotCount() const
+{
+	int32 LiveBots = 0;
+	for (ATankBotController* Bot : Bots)
+	{
+		APawnTank* Tank = Bot ? Cast<APawnTank>(Bot->GetPawn()) : nullptr;
+		if (Tank && Tank->GetIsPlayerAlive())
+		{
+			LiveBots++;
+		}
+	}
+	return LiveBots;
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Turns the samples of the current step into its results		////////
+void ATankLoadTestGameMode::FinishStep()
+{
+	bIsSampling = false;
+	FLoadTestStats::bIsRecording = false;
+
+	FStepResult& Result = Results.AddDefaulted_GetRef();
+	Result.PlayerCount = MinLivePlayers; // Dead bots don't count, so this is the fewest live players any frame was sampled with
+	Result.FrameCount = FrameTickMs.Num();
+
+	if (Result.FrameCount == 0 || Result.PlayerCount == 0)
+	{
+		return;
+	}
+
+	FrameTickMs.Sort();
+	auto Percentile = [this](float Fraction)
+	{
+		int32 Index = FMath::Clamp(FMath::CeilToInt(Fraction * FrameTickMs.Num()) - 1, 0, FrameTickMs.Num() - 1);
+		return FrameTickMs[Index];
+	};
+
+	Result.TickMsP50 = Percentile(0.50f);
+	Result.TickMsP90 = Percentile(0.90f);
+	Result.TickMsP99 = Percentile(0.99f);
+	Result.TickMsMax = FrameTickMs.Last();
+
+	for (int32 SystemIndex = 0; SystemIndex < (int32)ELoadTestSystem::Count; SystemIndex++)
+	{
+		Result.SystemMsAverage[SystemIndex] = (float)(SystemSecondsTotal[SystemIndex] * 1000.0 / Result.FrameCount);
+	}
+	Result.WorldTickMsAverage = (float)(WorldTickSecondsTotal * 1000.0 / Result.FrameCount);
+	Result.EndOfFrameMsAverage = (float)(EndOfFrameSecondsTotal * 1000.0 / Result.FrameCount);
+
+	// Everything the world grew by since the baseline is charged to the players (their Tanks, bots, projectiles, pick ups...)
+	uint64 UsedMemory = FPlatformMemory::GetStats().UsedPhysical;
+	uint64 GrownMemory = UsedMemory > BaselineMemory ? UsedMemory - BaselineMemory : 0;
+	Result.MemoryPerPlayerMB = (float)((double)GrownMemory / FMath::Max(1, GetLiveBotCount()) / (1024.0 * 1024.0));
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Spawns a Tank around the player start and a bot controller to possess it		////////
+bool ATankLoadTestGameMode::SpawnBot()
+{
+	CRAZYTANK_HITCH_SCOPE("LoadTest.SpawnBot");
+
+	AActor* PlayerStart = FindPlayerStart(nullptr);
+	FVector Center = PlayerStart ? PlayerStart->GetActorLocation() : FVector::ZeroVector;
+	FVector2D Offset = FMath::RandPointInCircle(SpawnRadius);
+	FVector SpawnLocation = Center + FVector(Offset.X, Offset.Y, 0.0f);
+	FRotator SpawnRotation = FRotator(0.0f, FMath::FRandRange(-180.0f, 180.0f), 0.0f);
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+	APawnTank* BotTank = GetWorld()->SpawnActor<APawnTank>(BotTankClass, SpawnLocation, SpawnRotation, SpawnParams);
+	ATankBotController* BotController = GetWorld()->SpawnActor<ATankBotController>(BotControllerClass, SpawnLocation, SpawnRotation, SpawnParams);
+	if (!BotTank || !BotController)
+	{
+		// Whichever half did spawn would be left in the world without the other, so it goes away too
+		if (BotTank)
+		{
+			BotTank->Destroy();
+		}
+		if (BotController)
+		{
+			BotController->Destroy();
+		}
+
+		UE_LOG(LogTemp, Warning, TEXT("Load test couldn't spawn a bot %s"), BotTank ? TEXT("controller") : TEXT("Tank"));
+		return false;
+	}
+
+	BotController->Possess(BotTank);
+	if (BotController->GetPawn() != BotTank)
+	{
+		BotTank->Destroy();
+		BotController->Destroy();
+
+		UE_LOG(LogTemp, Warning, TEXT("Load test's bot controller couldn't possess its Tank"));
+		return false;
+	}
+
+	Bots.Add(BotController);
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////
+
+////////		Logs the results and saves them as a CSV file		////////
+void ATankLoadTestGameMode::WriteReport()
+{
+	FString Header = TEXT("Players,Frames,TickP50Ms,TickP90Ms,TickP99Ms,TickMaxMs,WorldTickMs,EndOfFrameMs");
+	for (int32 SystemIndex = 0; SystemIndex < (int32)ELoadTestSystem::Count; SystemIndex++)
+	{
+		Header += FString::Printf(TEXT(",%sMs"), FLoadTestStats::GetSystemName((ELoadTestSystem)SystemIndex));
+	}
+	Header += TEXT(",MemoryPerPlayerMB");
+
+	FString Csv = Header + LINE_TERMINATOR;
+	UE_LOG(LogTemp, Display, TEXT("Load test results:"));
+	UE_LOG(LogTemp, Display, TEXT("%s"), *Header);
+
+	for (const FStepResult& Result : Results)
+	{
+		FString Row = FString::Printf
+		(
+			TEXT("%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f"),
+			Result.PlayerCount,
+			Result.FrameCount,
+			Result.TickMsP50,
+			Result.TickMsP90,
+			Result.TickMsP99,
+			Result.TickMsMax,
+			Result.WorldTickMsAverage,
+			Result.EndOfFrameMsAverage
+		);
+		for (float SystemMs : Result.SystemMsAverage)
+		{
+			Row += FString::Printf(TEXT(",%.3f"), SystemMs);
+		}
+		Row += FString::Printf(TEXT(",%.3f"), Result.MemoryPerPlayerMB);
+
+		UE_LOG(LogTemp, Display, TEXT("%s"), *Row);
+		Csv += Row + LINE_TERMINATOR;
+	}
+
+	FString ReportPath = FPaths::ProjectSavedDir() / TEXT("LoadTest") / FString::Printf(TEXT("LoadTest_%s.csv"), *FDateTime::Now().ToString());
+	if (FFileHelper::SaveStringToFile(Csv, *ReportPath))
+	{
+		UE_LOG(LogTemp, Display, TEXT("Load test report saved to %s"), *ReportPath);
+	}
+	else
+	{
+		UE_LOG(LogTemp, Error, TEXT("Load test couldn't save its report to %s"), *ReportPath);
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+
+/*
+
+	Frame timing delegates
+
+*/
+
+void ATankLoadTestGameMode::OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld())
+	{
+		return;
+	}
+
+	FrameStartTime = FPlatformTime::Seconds();
+	PostActorTickTime = FrameStartTime;
+	FLoadTestStats::ResetFrame();
+}
+
+void ATankLoadTestGameMode::OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != GetWorld())
+	{
+		return;
+	}
+
+	PostActorTickTime = FPlatformTime::Seconds();
+}
+
+void ATankLoadTestGameMode::OnEndFrame()
+{
+	if (!bIsSampling || FrameStartTime == 0.0)
+	{
+		return;
+	}
+
+	double FrameEndTime = FPlatformTime::Seconds();
+	FrameTickMs.Add((float)((FrameEndTime - FrameStartTime) * 1000.0));
+	WorldTickSecondsTotal += PostActorTickTime - FrameStartTime;
+	EndOfFrameSecondsTotal += FrameEndTime - PostActorTickTime;
+
+	for (int32 SystemIndex = 0; SystemIndex < (int32)ELoadTestSystem::Count; SystemIndex++)
+	{
+		SystemSecondsTotal[SystemIndex] += FLoadTestStats::SystemSeconds[SystemIndex];
+	}
+}
@@ -0,0 +1,169 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/GameModeBase.h"
+#include "LoadTestStats.h"
+#include "TankLoadTestGameMode.generated.h"
+
+/*
+
+	Crazy Tank classes
+
+*/
+
+class APawnTank;
+class ATankBotController;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This class load tests a headless dedicated server: it spawns more and more bot-driven Tanks
+// and reports how the server's tick time and memory grow with the player count
+//
+// Linux usage (no clients and no rendering are needed):
+//	CrazyTankServer <Map>?game=/Script/CrazyTank.TankLoadTestGameMode -log -nullrhi
+//		-LoadTestTankClass=<Tank Blueprint class path>	Tank class to spawn (when it isn't set in a Blueprint child)
+//		-LoadTestMaxPlayers=N							Stop after the step with N players (64 by default)
+//
+// The report is written to the log and as CSV to Saved/LoadTest/, then the server exits
+//
+//////////////////////////////////////////////////////////////////////////////
+UCLASS()
+class CRAZYTANK_API ATankLoadTestGameMode : public AGameModeBase
+{
+	GENERATED_BODY()
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	UPROPERTY(EditDefaultsOnly, Category = "Load Test")
+	TSubclassOf<APawnTank> BotTankClass; // Blueprint Tank class possessed by every bot
+
+	UPROPERTY(EditDefaultsOnly, Category = "Load Test")
+	TSubclassOf<ATankBotController> BotControllerClass; // Controller driving every bot Tank
+
+	UPROPERTY(EditDefaultsOnly, Category = "Load Test")
+	TArray<int32> PlayerCountSteps = { 1, 2, 4, 8, 16, 24, 32, 48, 64 }; // Amount of bots measured on every step
+
+	UPROPERTY(EditDefaultsOnly, Category = "Load Test")
+	float WarmUpSeconds = 5.0f; // Time given to every step to settle after spawning its bots, before measuring
+
+	UPROPERTY(EditDefaultsOnly, Category = "Load Test")
+	float SampleSeconds = 15.0f; // Time every step is measured for
+
+	UPROPERTY(EditDefaultsOnly, Category = "Load Test")
+	float SpawnRadius = 4000.0f; // Bots are spawned around the player start, within this radius
+
+	UPROPERTY(EditDefaultsOnly, Category = "Load Test")
+	int32 MaxSpawnAttemptsPerBot = 4; // A step gives up (and the load test ends) when its bots fail to spawn this many times each
+
+	// Results of one step of the load test
+	struct FStepResult
+	{
+		int32 PlayerCount = 0;
+
+		int32 FrameCount = 0;
+
+		float TickMsP50 = 0.0f;
+
+		float TickMsP90 = 0.0f;
+
+		float TickMsP99 = 0.0f;
+
+		float TickMsMax = 0.0f;
+
+		float SystemMsAverage[(int32)ELoadTestSystem::Count] = {};
+
+		float WorldTickMsAverage = 0.0f; // From the start of the world's tick to the end of the actors' tick
+
+		float EndOfFrameMsAverage = 0.0f; // From the end of the actors' tick to the end of the frame (net flush, GC...)
+
+		float MemoryPerPlayerMB = 0.0f;
+	};
+
+	TArray<FStepResult> Results;
+
+	UPROPERTY()
+	TArray<ATankBotController*> Bots; // Every bot spawned so far, dead ones are replaced so every step measures live players only
+
+	int32 CurrentStep = INDEX_NONE;
+
+	int32 MaxPlayers = 64;
+
+	float StepTime = 0.0f; // Time spent in the current step
+
+	bool bIsSampling = false;
+
+	int32 MinLivePlayers = 0; // Fewest live bots seen in a sampled frame of the current step
+
+	uint64 BaselineMemory = 0; // Physical memory used before spawning any bot
+
+	double FrameStartTime = 0.0;
+
+	double PostActorTickTime = 0.0;
+
+	TArray<float> FrameTickMs; // Every sampled frame's tick time in the current step
+
+	double SystemSecondsTotal[(int32)ELoadTestSystem::Count] = {};
+
+	double WorldTickSecondsTotal = 0.0;
+
+	double EndOfFrameSecondsTotal = 0.0;
+
+	FDelegateHandle WorldTickStartHandle;
+
+	FDelegateHandle PostActorTickHandle;
+
+	FDelegateHandle EndFrameHandle;
+
+	/*
+		METHODS
+	*/
+
+	bool StartStep(int32 StepIndex); // Spawns the bots needed to reach the step's player count, false if they couldn't be spawned
+
+	void FinishStep(); // Turns the samples of the current step into its results
+
+	bool SpawnBot(); // Spawns a Tank around the player start and a bot controller to possess it, false if either couldn't be spawned
+
+	bool FillBots(int32 PlayerCount); // Replaces the dead bots and spawns new ones until PlayerCount bots are alive, false if they couldn't be spawned
+
+	void RemoveDeadBots(); // Destroys the bots whose Tank died (or went away), their dead Tank is destroyed shortly after
+
+	int32 GetLiveBotCount() const;
+
+	void FinishLoadTest(); // Writes the report of every finished step and closes the server
+
+	void WriteReport(); // Logs the results and saves them as a CSV file
+
+	void OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	void OnEndFrame();
+
+public:
+
+	/*
+		METHODS
+	*/
+
+	ATankLoadTestGameMode(); // Sets default values for this game mode's properties
+
+	virtual void StartPlay() override; // Starts the load test once the world begins play
+
+	virtual void Tick(float DeltaSeconds) override; // Called every frame
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+};
@@ -0,0 +1,323 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "TurretAimSubsystem.h"
+#include "Engine/World.h"
+#include "Math/VectorRegister.h"
+#include "PawnTank.h"
+#include "PawnTurret.h"
+#include "LoadTestStats.h"
+#include "HitchCapture.h"
+
+// Inputs and outputs of the lead solver, every one of them is a lane of floats (one float per Turret)
+enum EAimLane
+{
+	OriginX,
+	OriginY,
+	OriginZ,
+	TargetX,
+	TargetY,
+	TargetZ,
+	VelocityX,
+	VelocityY,
+	VelocityZ,
+	ProjectileSpeed,
+	RangeSquared,
+	OutYaw,
+	OutPitch,
+	OutInRange,
+	AimLaneCount
+};
+
+// A target can't be led further than this, so a target running almost as fast as the projectile isn't aimed at the horizon
+static const float MaxLeadSeconds = 3.0f;
+
+// Square root that's safe to call with 0 (x * 1/sqrt(x) would be 0 * infinity)
+static FORCEINLINE VectorRegister SafeVectorSqrt(const VectorRegister& Value)
+{
+	VectorRegister Clamped = VectorMax(Value, VectorSetFloat1(SMALL_NUMBER));
+	return VectorMultiply(Clamped, VectorReciprocalSqrtAccurate(Clamped));
+}
+
+// Solves the intercept time of 4 Turrets at once for every group of 4 lanes:
+// the projectile (speed S from O) meets the target (at T moving with V) when |T + V*t - O| = S*t,
+// that is (V.V - S^2)*t^2 + 2*(D.V)*t + D.D = 0 with D = T - O. The smallest positive root is used.
+static void SolveLeadBatch(float* const* Lanes, int32 LaneCount)
+{
+	const VectorRegister Zero = VectorZero();
+	const VectorRegister One = VectorOne();
+	const VectorRegister Two = VectorSetFloat1(2.0f);
+	const VectorRegister Four = VectorSetFloat1(4.0f);
+	const VectorRegister Epsilon = VectorSetFloat1(KINDA_SMALL_NUMBER);
+	const VectorRegister MaxLead = VectorSetFloat1(MaxLeadSeconds);
+	const VectorRegister RadiansToDegrees = VectorSetFloat1(180.0f / PI);
+
+	for (int32 Index = 0; Index < LaneCount; Index += 4)
+	{
+		// Relative position and velocity of the target
+		VectorRegister Dx = VectorSubtract(VectorLoadAligned(Lanes[TargetX] + Index), VectorLoadAligned(Lanes[OriginX] + Index));
+		VectorRegister Dy = VectorSubtract(VectorLoadAligned(Lanes[TargetY] + Index), VectorLoadAligned(Lanes[OriginY] + Index));
+		VectorRegister Dz = VectorSubtract(VectorLoadAligned(Lanes[TargetZ] + Index), VectorLoadAligned(Lanes[OriginZ] + Index));
+		VectorRegister Vx = VectorLoadAligned(Lanes[VelocityX] + Index);
+		VectorRegister Vy = VectorLoadAligned(Lanes[VelocityY] + Index);
+		VectorRegister Vz = VectorLoadAligned(Lanes[VelocityZ] + Index);
+		VectorRegister Speed = VectorLoadAligned(Lanes[ProjectileSpeed] + Index);
+
+		VectorRegister DD = VectorMultiplyAdd(Dz, Dz, VectorMultiplyAdd(Dy, Dy, VectorMultiply(Dx, Dx)));
+		VectorRegister DV = VectorMultiplyAdd(Dz, Vz, VectorMultiplyAdd(Dy, Vy, VectorMultiply(Dx, Vx)));
+		VectorRegister VV = VectorMultiplyAdd(Vz, Vz, VectorMultiplyAdd(Vy, Vy, VectorMultiply(Vx, Vx)));
+
+		VectorRegister A = VectorSubtract(VV, VectorMultiply(Speed, Speed));
+		VectorRegister B = VectorMultiply(Two, DV);
+		VectorRegister C = DD;
+
+		// Quadratic case
+		VectorRegister Discriminant = VectorSubtract(VectorMultiply(B, B), VectorMultiply(Four, VectorMultiply(A, C)));
+		VectorRegister HasRoots = VectorCompareGE(Discriminant, Zero);
+		VectorRegister SqrtDiscriminant = SafeVectorSqrt(Discriminant);
+
+		VectorRegister IsLinear = VectorCompareGT(Epsilon, VectorAbs(A));
+		VectorRegister InvTwoA = VectorReciprocalAccurate(VectorMultiply(Two, VectorSelect(IsLinear, One, A)));
+		VectorRegister NegB = VectorNegate(B);
+		VectorRegister T1 = VectorMultiply(VectorSubtract(NegB, SqrtDiscriminant), InvTwoA);
+		VectorRegister T2 = VectorMultiply(VectorAdd(NegB, SqrtDiscriminant), InvTwoA);
+		VectorRegister TMin = VectorMin(T1, T2);
+		VectorRegister TMax = VectorMax(T1, T2);
+		VectorRegister TQuadratic = VectorSelect(VectorCompareGT(TMin, Zero), TMin, VectorSelect(VectorCompareGT(TMax, Zero), TMax, Zero));
+		TQuadratic = VectorSelect(HasRoots, TQuadratic, Zero);
+
+		// Linear case (projectile as fast as the target): B*t + C = 0, only solvable when the target comes closer (B < 0)
+		VectorRegister IsApproaching = VectorCompareGT(VectorNegate(Epsilon), B);
+		VectorRegister SafeB = VectorSelect(IsApproaching, B, VectorNegate(One));
+		VectorRegister TLinear = VectorSelect(IsApproaching, VectorMultiply(VectorNegate(C), VectorReciprocalAccurate(SafeB)), Zero);
+
+		VectorRegister Time = VectorMin(VectorSelect(IsLinear, TLinear, TQuadratic), MaxLead);
+
+		// Aim at where the target will be when the projectile gets there
+		VectorRegister Ax = VectorMultiplyAdd(Vx, Time, Dx);
+		VectorRegister Ay = VectorMultiplyAdd(Vy, Time, Dy);
+		VectorRegister Az = VectorMultiplyAdd(Vz, Time, Dz);
+		VectorRegister Horizontal = SafeVectorSqrt(VectorMultiplyAdd(Ay, Ay, VectorMultiply(Ax, Ax)));
+
+		VectorStoreAligned(VectorMultiply(VectorATan2(Ay, Ax), RadiansToDegrees), Lanes[OutYaw] + Index);
+		VectorStoreAligned(VectorMultiply(VectorATan2(Az, Horizontal), RadiansToDegrees), Lanes[OutPitch] + Index);
+		VectorStoreAligned(VectorSelect(VectorCompareGE(VectorLoadAligned(Lanes[RangeSquared] + Index), DD), One, Zero), Lanes[OutInRange] + Index);
+	}
+}
+
+////////		Starts aiming a Turret (called when it begins play)		////////
+void UTurretAimSubsystem::RegisterTurret(APawnTurret* Turret)
+{
+	if (!Turret || AimedTurrets.ContainsByPredicate([Turret](const FAimedTurret& Aimed) { return Aimed.Turret.Get() == Turret; }))
+	{
+		return;
+	}
+
+	FAimedTurret& Aimed = AimedTurrets.AddDefaulted_GetRef();
+	Aimed.Turret = Turret;
+	Aimed.Origin = Turret->TurretMesh->GetComponentLocation();
+	Aimed.ProjectileSpeed = Turret->GetAimProjectileSpeed();
+	Aimed.RangeSquared = FMath::Square(Turret->FireRange);
+	Aimed.TurnRate = Turret->AimTurnRate;
+	Aimed.MinPitch = Turret->MinAimPitch;
+	Aimed.MaxPitch = Turret->MaxAimPitch;
+	Aimed.CurrentYaw = Turret->TurretMesh->GetComponentRotation().Yaw;
+	Aimed.CurrentPitch = 0.0f;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Stops aiming a Turret (destroyed, or its target is dead)		////////
+void UTurretAimSubsystem::UnregisterTurret(APawnTurret* Turret)
+{
+	int32 AimedIndex = AimedTurrets.IndexOfByPredicate([Turret](const FAimedTurret& Aimed) { return Aimed.Turret.Get() == Turret; });
+	if (AimedIndex != INDEX_NONE)
+	{
+		AimedTurrets.RemoveAtSwap(AimedIndex);
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Lets Turrets target a Tank		////////
+void UTurretAimSubsystem::RegisterTarget(APawnTank* Tank)
+{
+	if (Tank)
+	{
+		Targets.AddUnique(Tank);
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Stops Turrets from targeting a Tank		////////
+void UTurretAimSubsystem::UnregisterTarget(APawnTank* Tank)
+{
+	Targets.RemoveSwap(Tank);
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		The closest live Tank within Range of Origin		////////
+APawnTank* UTurretAimSubsystem::FindClosestTarget(const FVector& Origin, float Range) const
+{
+	APawnTank* ClosestTarget = nullptr;
+	float ClosestDistSquared = FMath::Square(Range);
+
+	for (const TWeakObjectPtr<APawnTank>& Target : Targets)
+	{
+		APawnTank* Tank = Target.Get();
+		if (!Tank || !Tank->GetIsPlayerAlive())
+		{
+			continue;
+		}
+
+		float DistSquared = FVector::DistSquared(Origin, Tank->GetActorLocation());
+		if (DistSquared <= ClosestDistSquared)
+		{
+			ClosestDistSquared = DistSquared;
+			ClosestTarget = Tank;
+		}
+	}
+
+	return ClosestTarget;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Solves and applies the aim of every registered Turret		////////
+void UTurretAimSubsystem::Tick(float DeltaTime)
+{
+	FLoadTestScope LoadTestScope(ELoadTestSystem::Turrets);
+	CRAZYTANK_HITCH_SCOPE("TurretAim.Tick");
+
+	GatherLanes();
+	if (SolvedTurrets.Num() == 0)
+	{
+		return;
+	}
+
+	float* Lanes[AimLaneCount];
+	for (int32 Lane = 0; Lane < AimLaneCount; Lane++)
+	{
+		Lanes[Lane] = GetLane(Lane);
+	}
+
+	SolveLeadBatch(Lanes, LaneStride);
+	ApplyResults(DeltaTime);
+}
+////////////////////////////////////////////////////////////////////////
+
+float* UTurretAimSubsystem::GetLane(int32 Lane)
+{
+	return LaneData.GetData() + Lane * LaneStride;
+}
+
+////////		Fills the solver's input lanes with every Turret that has a live target		////////
+void UTurretAimSubsystem::GatherLanes()
+{
+	// Turrets collected without unregistering are removed first: removing them while SolvedTurrets is being filled
+	// would swap other Turrets around and leave SolvedTurrets pointing at the wrong entries
+	AimedTurrets.RemoveAllSwap([](const FAimedTurret& Aimed) { return !Aimed.Turret.IsValid(); });
+
+	SolvedTurrets.Reset();
+	for (int32 AimedIndex = 0; AimedIndex < AimedTurrets.Num(); AimedIndex++)
+	{
+		APawnTurret* Turret = AimedTurrets[AimedIndex].Turret.Get();
+		if (Turret->TargetTank && Turret->TargetTank->GetIsPlayerAlive())
+		{
+			AimedTurrets[AimedIndex].ProjectileSpeed = Turret->GetAimProjectileSpeed();
+			SolvedTurrets.Add(AimedIndex);
+		}
+	}
+
+	// Lanes are a multiple of 4 floats long, so every lane starts 16 bytes aligned and the solver never reads past it
+	LaneStride = Align(SolvedTurrets.Num(), 4);
+	LaneData.Reset();
+	LaneData.SetNumZeroed(LaneStride * AimLaneCount, false);
+
+	float* Lanes[AimLaneCount];
+	for (int32 Lane = 0; Lane < AimLaneCount; Lane++)
+	{
+		Lanes[Lane] = GetLane(Lane);
+	}
+
+	// Most Turrets share the same target, so its location and velocity are only read again when it changes
+	const APawnTank* LastTarget = nullptr;
+	FVector TargetLocation = FVector::ZeroVector;
+	FVector TargetVelocity = FVector::ZeroVector;
+
+	for (int32 LaneIndex = 0; LaneIndex < SolvedTurrets.Num(); LaneIndex++)
+	{
+		const FAimedTurret& Aimed = AimedTurrets[SolvedTurrets[LaneIndex]];
+		const APawnTank* Target = Aimed.Turret->TargetTank;
+		if (Target != LastTarget)
+		{
+			LastTarget = Target;
+			TargetLocation = Target->GetActorLocation();
+			TargetVelocity = Target->GetVelocity();
+		}
+
+		Lanes[OriginX][LaneIndex] = Aimed.Origin.X;
+		Lanes[OriginY][LaneIndex] = Aimed.Origin.Y;
+		Lanes[OriginZ][LaneIndex] = Aimed.Origin.Z;
+		Lanes[TargetX][LaneIndex] = TargetLocation.X;
+		Lanes[TargetY][LaneIndex] = TargetLocation.Y;
+		Lanes[TargetZ][LaneIndex] = TargetLocation.Z;
+		Lanes[VelocityX][LaneIndex] = TargetVelocity.X;
+		Lanes[VelocityY][LaneIndex] = TargetVelocity.Y;
+		Lanes[VelocityZ][LaneIndex] = TargetVelocity.Z;
+		Lanes[ProjectileSpeed][LaneIndex] = Aimed.ProjectileSpeed;
+		Lanes[RangeSquared][LaneIndex] = Aimed.RangeSquared;
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Clamps the solved aim, limits it by turn rate and applies it to the Turrets		////////
+void UTurretAimSubsystem::ApplyResults(float DeltaTime)
+{
+	const float* Yaws = GetLane(OutYaw);
+	const float* Pitches = GetLane(OutPitch);
+	const float* InRange = GetLane(OutInRange);
+
+	for (int32 LaneIndex = 0; LaneIndex < SolvedTurrets.Num(); LaneIndex++)
+	{
+		if (InRange[LaneIndex] == 0.0f)
+		{
+			// Out of the Turret's fire range, it keeps looking where it was
+			continue;
+		}
+
+		FAimedTurret& Aimed = AimedTurrets[SolvedTurrets[LaneIndex]];
+		float MaxTurn = Aimed.TurnRate * DeltaTime;
+		float TargetPitch = FMath::Clamp(Pitches[LaneIndex], Aimed.MinPitch, Aimed.MaxPitch);
+
+		Aimed.CurrentYaw = FMath::FixedTurn(Aimed.CurrentYaw, Yaws[LaneIndex], MaxTurn);
+		Aimed.CurrentPitch = FMath::FixedTurn(Aimed.CurrentPitch, TargetPitch, MaxTurn);
+
+		Aimed.Turret->ApplyAim(Aimed.CurrentYaw, Aimed.CurrentPitch);
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Called when the world is torn down		////////
+void UTurretAimSubsystem::Deinitialize()
+{
+	AimedTurrets.Empty();
+	SolvedTurrets.Empty();
+	Targets.Empty();
+	LaneData.Empty();
+
+	Super::Deinitialize();
+}
+////////////////////////////////////////////////////////////////////////
+
+bool UTurretAimSubsystem::HasWorkToTick() const
+{
+	return AimedTurrets.Num() > 0;
+}
+
+TStatId UTurretAimSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTurretAimSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,117 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CrazyTankTickableWorldSubsystem.h"
+#include "TurretAimSubsystem.generated.h"
+
+/*
+
+	Crazy Tank classes
+
+*/
+
+class APawnTank;
+class APawnTurret;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This class aims every Turret in range with lead: it solves where each Turret's projectile meets its moving target
+// for all the Turrets at once (4 Turrets per SIMD operation), then turns them towards that point within their turn rate
+//
+//////////////////////////////////////////////////////////////////////////////
+UCLASS()
+class CRAZYTANK_API UTurretAimSubsystem : public UCrazyTankTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	// A Turret aimed by the solver, with the settings that don't change while it's alive
+	struct FAimedTurret
+	{
+		TWeakObjectPtr<APawnTurret> Turret;
+
+		FVector Origin = FVector::ZeroVector; // The turret mesh's pivot, Turrets don't move
+
+		float ProjectileSpeed = 0.0f; // Read again every tick, it depends on whether projectiles are simulated (a CVar can change it)
+
+		float RangeSquared = 0.0f;
+
+		float TurnRate = 0.0f; // Degrees per second
+
+		float MinPitch = 0.0f;
+
+		float MaxPitch = 0.0f;
+
+		float CurrentYaw = 0.0f;
+
+		float CurrentPitch = 0.0f;
+	};
+
+	TArray<FAimedTurret> AimedTurrets;
+
+	TArray<TWeakObjectPtr<APawnTank>> Targets; // Every Tank the Turrets can target (players and bots)
+
+	TArray<int32> SolvedTurrets; // Index in AimedTurrets of every Turret solved this frame, one per lane
+
+	TArray<float, TAlignedHeapAllocator<16>> LaneData; // Every input and output lane of the solver, one after the other
+
+	int32 LaneStride = 0; // Floats in every lane, rounded up to a multiple of 4
+
+	/*
+		METHODS
+	*/
+
+	float* GetLane(int32 Lane); // Start of a lane in LaneData
+
+	void GatherLanes(); // Fills the solver's input lanes with every Turret that has a live target
+
+	void ApplyResults(float DeltaTime); // Clamps the solved aim, limits it by turn rate and applies it to the Turrets
+
+public:
+
+	/*
+		METHODS
+	*/
+
+	void RegisterTurret(APawnTurret* Turret); // Starts aiming a Turret (called when it begins play)
+
+	void UnregisterTurret(APawnTurret* Turret); // Stops aiming a Turret (destroyed)
+
+	void RegisterTarget(APawnTank* Tank); // Lets Turrets target a Tank (called when it begins play)
+
+	void UnregisterTarget(APawnTank* Tank); // Stops Turrets from targeting a Tank (destroyed or removed from the world)
+
+	APawnTank* FindClosestTarget(const FVector& Origin, float Range) const; // The closest live Tank within Range of Origin, if any
+
+	virtual void Deinitialize() override; // Called when the world is torn down
+
+	/*
+		FTickableGameObject interface
+	*/
+
+	virtual void Tick(float DeltaTime) override; // Solves and applies the aim of every registered Turret
+
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/*
+		METHODS
+	*/
+
+	virtual bool HasWorkToTick() const override; // While Turrets are registered
+
+};
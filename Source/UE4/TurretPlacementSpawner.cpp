@@ -0,0 +1,194 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "TurretPlacementSpawner.h"
+#include "Kismet/GameplayStatics.h"
+#include "CrazyTank/Actors/PickUpBase.h"
+#include "PawnTank.h"
+#include "PawnTurret.h"
+#include "FrameArena.h"
+#include "HitchCapture.h"
+
+////////		Sets default values for this actor's properties		////////
+ATurretPlacementSpawner::ATurretPlacementSpawner()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false; // Only ticks once a table has been loaded
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Called when the game starts or when spawned		////////
+void ATurretPlacementSpawner::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Without cooked data the baked Turrets haven't been stripped from the map, spawning them again would double them
+	if (!FPlatformProperties::RequiresCookedData())
+	{
+		return;
+	}
+
+	if (LoadTable())
+	{
+		SetActorTickEnabled(true);
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Unmaps the table		////////
+void ATurretPlacementSpawner::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Table.Unload();
+	TableClasses.Empty();
+	SpawnedRecords.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Maps the placement table and loads its classes		////////
+bool ATurretPlacementSpawner::LoadTable()
+{
+	// A spawner placed in a streamed level spawns that level's table, its package is the one the commandlet baked
+	FString MapName = TableMapName.IsEmpty() ? GetLevel()->GetOutermost()->GetName() : TableMapName;
+	MapName = UWorld::RemovePIEPrefix(MapName); // PIE package names carry a prefix in their last path segment
+	FString TableFilename = FTurretPlacementTable::GetTableFilename(MapName);
+
+	double LoadStartTime = FPlatformTime::Seconds();
+	if (!Table.Load(TableFilename))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("No Turret placement table found for %s (%s)"), *MapName, *TableFilename);
+		return false;
+	}
+
+	// Only a handful of classes are shared by every record, so they are all loaded up front
+	TableClasses.Reserve(Table.GetClassPaths().Num());
+	for (const FString& ClassPath : Table.GetClassPaths())
+	{
+		UClass* TableClass = LoadObject<UClass>(nullptr, *ClassPath);
+		if (!TableClass)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Turret placement table %s uses class %s, which couldn't be loaded"), *TableFilename, *ClassPath);
+		}
+		TableClasses.Add(TableClass);
+	}
+
+	SpawnedRecords.Init(false, Table.Num());
+	NumSpawnedRecords = 0;
+	NextRecordToCheck = 0;
+
+	UE_LOG
+	(
+		LogTemp,
+		Display,
+		TEXT("Turret placement table %s: %d Turrets, %llu KB %s in %.2f ms"),
+		*TableFilename,
+		Table.Num(),
+		(uint64)Table.GetFileSize() / 1024,
+		Table.IsMapped() ? TEXT("mapped") : TEXT("read"),
+		(FPlatformTime::Seconds() - LoadStartTime) * 1000.0
+	);
+
+	return Table.Num() > 0;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Spawns the Turrets that came within ActivationRadius		////////
+void ATurretPlacementSpawner::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Without a player (e.g. a dedicated server with no one connected yet) every Turret is spawned, still a few per frame
+	APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+	FVector PlayerLocation = PlayerPawn ? PlayerPawn->GetActorLocation() : FVector::ZeroVector;
+	float ActivationRadiusSquared = FMath::Square(ActivationRadius);
+
+	int32 NumRecords = Table.Num();
+	int32 NumChecks = FMath::Min(MaxChecksPerFrame, NumRecords);
+	int32 NumSpawns = 0;
+
+	for (int32 Check = 0; Check < NumChecks && NumSpawns < MaxSpawnsPerFrame; Check++)
+	{
+		int32 RecordIndex = NextRecordToCheck;
+		NextRecordToCheck = (NextRecordToCheck + 1) % NumRecords;
+
+		if (SpawnedRecords[RecordIndex])
+		{
+			continue;
+		}
+
+		const FTurretPlacementRecord& Record = Table.GetRecord(RecordIndex);
+		if (PlayerPawn && FVector::DistSquared(Record.Location, PlayerLocation) > ActivationRadiusSquared)
+		{
+			continue;
+		}
+
+		SpawnTurret(RecordIndex);
+		NumSpawns++;
+	}
+
+	if (NumSpawnedRecords == NumRecords)
+	{
+		// Every Turret is in the world, the table isn't needed anymore
+		Table.Unload();
+		SetActorTickEnabled(false);
+	}
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Spawns the Turret of one record		////////
+void ATurretPlacementSpawner::SpawnTurret(int32 RecordIndex)
+{
+	CRAZYTANK_HITCH_SCOPE("TurretPlacement.SpawnTurret");
+
+	// Whatever happens, this record is done with
+	SpawnedRecords[RecordIndex] = true;
+	NumSpawnedRecords++;
+
+	const FTurretPlacementRecord& Record = Table.GetRecord(RecordIndex);
+	if (!Table.IsRecordValid(Record))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Turret placement record %d is corrupted, it's skipped"), RecordIndex);
+		return;
+	}
+
+	UClass* TurretClass = TableClasses[Record.ClassIndex];
+	if (!TurretClass || !TurretClass->IsChildOf(APawnTurret::StaticClass()))
+	{
+		return;
+	}
+
+	// The Pick Up classes are only needed until the Turret copies them, they live in the frame arena until then
+	FFrameArenaScope ArenaScope;
+	TFrameArray< TSubclassOf<APickUpBase> > PickUpClass;
+	PickUpClass.Reserve(Record.NumPickUps);
+	for (uint16 PickUpIndex : Table.GetPickUpIndices(Record))
+	{
+		UClass* PickUp = TableClasses[PickUpIndex];
+		if (PickUp && PickUp->IsChildOf(APickUpBase::StaticClass()))
+		{
+			PickUpClass.Add(PickUp);
+		}
+	}
+
+	// Deferred, so the table's settings are in place before the Turret's BeginPlay() sets its fire timer.
+	// The Turret goes into the spawner's level, so it's unloaded with it when that level is streamed out
+	FTransform SpawnTransform(Record.Rotation, Record.Location, Record.Scale);
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.OverrideLevel = GetLevel();
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParameters.bDeferConstruction = true;
+	APawnTurret* Turret = GetWorld()->SpawnActor<APawnTurret>(TurretClass, SpawnTransform, SpawnParameters);
+
+	if (Turret)
+	{
+		Turret->ApplyPlacement(Record, PickUpClass);
+		Turret->FinishSpawning(SpawnTransform);
+	}
+}
+////////////////////////////////////////////////////////////////////////
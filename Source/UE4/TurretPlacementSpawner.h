@@ -0,0 +1,88 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "TurretPlacementTable.h"
+#include "TurretPlacementSpawner.generated.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This class spawns the Turrets baked into its level's placement table. The table stays as data (memory-mapped)
+// and only the Turrets within ActivationRadius of the player are spawned, a few per frame,
+// so a map with thousands of Turrets loads as fast as the table can be mapped
+//
+// Only cooked builds use the table: the editor and uncooked games still have the authored Turrets in the map
+//
+//////////////////////////////////////////////////////////////////////////////
+UCLASS()
+class CRAZYTANK_API ATurretPlacementSpawner : public AActor
+{
+	GENERATED_BODY()
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Placement", meta = (AllowPrivateAccess = "true"))
+	FString TableMapName; // Package of the map whose placement table is spawned (e.g. /Game/Maps/Level1), this spawner's own level when empty
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Placement", meta = (AllowPrivateAccess = "true"))
+	float ActivationRadius = 8000.0f; // Turrets closer than this to the player are spawned
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Placement", meta = (AllowPrivateAccess = "true"))
+	int32 MaxSpawnsPerFrame = 8; // Spawning is spread across frames so a crowded area doesn't hitch
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Placement", meta = (AllowPrivateAccess = "true"))
+	int32 MaxChecksPerFrame = 1024; // Records checked against ActivationRadius every frame, continuing where the last frame stopped
+
+	FTurretPlacementTable Table;
+
+	UPROPERTY()
+	TArray<UClass*> TableClasses; // The table's class paths, loaded once (nullptr when a class couldn't be loaded)
+
+	TBitArray<> SpawnedRecords; // Records already spawned (or skipped), they are never spawned again
+
+	int32 NumSpawnedRecords = 0;
+
+	int32 NextRecordToCheck = 0;
+
+	/*
+		METHODS
+	*/
+
+	bool LoadTable(); // Maps the placement table and loads its classes
+
+	void SpawnTurret(int32 RecordIndex); // Spawns the Turret of one record
+
+public:
+
+	/*
+		METHODS
+	*/
+
+	ATurretPlacementSpawner(); // Sets default values for this actor's properties
+
+	virtual void Tick(float DeltaTime) override; // Spawns the Turrets that came within ActivationRadius
+
+protected:
+
+	/*
+		METHODS
+	*/
+
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override; // Unmaps the table
+
+};
@@ -0,0 +1,242 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#include "TurretPlacementTable.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+// Records are read in place, so their layout is the file format
+static_assert(sizeof(FTurretPlacementRecord) == 72, "FTurretPlacementRecord layout changed, bump FTurretPlacementTable::FileVersion");
+static_assert(sizeof(FTurretPlacementHeader) == 36, "FTurretPlacementHeader layout changed, bump FTurretPlacementTable::FileVersion");
+
+FTurretPlacementTable::FTurretPlacementTable()
+{
+}
+
+FTurretPlacementTable::~FTurretPlacementTable()
+{
+	Unload();
+}
+
+////////		Content/TurretPlacement/<Map>.ctt, named after the map's whole package path		////////
+FString FTurretPlacementTable::GetTableFilename(const FString& MapPackageName)
+{
+	// Package names can't contain dots, so replacing the slashes with them can't make two maps share a file
+	FString TableName = MapPackageName;
+	TableName.RemoveFromStart(TEXT("/"));
+	TableName.ReplaceCharInline(TEXT('/'), TEXT('.'));
+
+	return FPaths::ProjectContentDir() / TEXT("TurretPlacement") / (TableName + TEXT(".ctt"));
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Maps the file (or reads it, when it can't be mapped) and validates it		////////
+bool FTurretPlacementTable::Load(const FString& Filename)
+{
+	Unload();
+
+	// Mapping only reserves address space, the pages holding the records are read when a Turret is spawned from them
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedFile.Reset(PlatformFile.OpenMapped(*Filename));
+	if (MappedFile)
+	{
+		MappedRegion.Reset(MappedFile->MapRegion());
+	}
+
+	if (MappedRegion)
+	{
+		FileData = MappedRegion->GetMappedPtr();
+		FileSize = MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		MappedFile.Reset();
+
+		if (!FFileHelper::LoadFileToArray(LoadedFile, *Filename, FILEREAD_Silent))
+		{
+			return false;
+		}
+
+		FileData = LoadedFile.GetData();
+		FileSize = LoadedFile.Num();
+	}
+
+	if (!ReadFileData())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Turret placement table %s is invalid or was cooked by another version"), *Filename);
+		Unload();
+		return false;
+	}
+
+	return true;
+}
+////////////////////////////////////////////////////////////////////////
+
+void FTurretPlacementTable::Unload()
+{
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	LoadedFile.Empty();
+	ClassPaths.Empty();
+
+	FileData = nullptr;
+	FileSize = 0;
+	Records = nullptr;
+	PickUpIndices = nullptr;
+	NumRecords = 0;
+	NumPickUpIndices = 0;
+}
+
+////////		Validates the header and points at the records and indices in FileData		////////
+bool FTurretPlacementTable::ReadFileData()
+{
+	if (FileSize < sizeof(FTurretPlacementHeader))
+	{
+		return false;
+	}
+
+	FTurretPlacementHeader Header;
+	FMemory::Memcpy(&Header, FileData, sizeof(Header));
+
+	if (Header.Magic != FileMagic || Header.Version != FileVersion)
+	{
+		return false;
+	}
+
+	// Every section must be inside the file, and the records must be aligned to be read in place
+	uint64 RecordsEnd = (uint64)Header.RecordsOffset + (uint64)Header.NumRecords * sizeof(FTurretPlacementRecord);
+	uint64 PickUpIndicesEnd = (uint64)Header.PickUpIndicesOffset + (uint64)Header.NumPickUpIndices * sizeof(uint16);
+	uint64 ClassPathsEnd = (uint64)Header.ClassPathsOffset + Header.ClassPathsSize;
+	if (RecordsEnd > FileSize || PickUpIndicesEnd > FileSize || ClassPathsEnd > FileSize
+		|| !IsAligned(Header.RecordsOffset, alignof(FTurretPlacementRecord))
+		|| !IsAligned(Header.PickUpIndicesOffset, alignof(uint16))
+		|| Header.NumRecords > MAX_int32 || Header.NumPickUpIndices > MAX_int32)
+	{
+		return false;
+	}
+
+	Records = reinterpret_cast<const FTurretPlacementRecord*>(FileData + Header.RecordsOffset);
+	NumRecords = (int32)Header.NumRecords;
+	PickUpIndices = reinterpret_cast<const uint16*>(FileData + Header.PickUpIndicesOffset);
+	NumPickUpIndices = (int32)Header.NumPickUpIndices;
+
+	// The class paths are null-terminated UTF-8 strings, one after the other
+	const ANSICHAR* ClassPath = reinterpret_cast<const ANSICHAR*>(FileData + Header.ClassPathsOffset);
+	const ANSICHAR* ClassPathsEndPtr = ClassPath + Header.ClassPathsSize;
+	ClassPaths.Reserve(Header.NumClassPaths);
+	for (uint32 PathIndex = 0; PathIndex < Header.NumClassPaths; PathIndex++)
+	{
+		const ANSICHAR* PathEnd = ClassPath;
+		while (PathEnd < ClassPathsEndPtr && *PathEnd != '\0')
+		{
+			PathEnd++;
+		}
+
+		if (PathEnd >= ClassPathsEndPtr)
+		{
+			return false;
+		}
+
+		ClassPaths.Add(UTF8_TO_TCHAR(ClassPath));
+		ClassPath = PathEnd + 1;
+	}
+
+	return true;
+}
+////////////////////////////////////////////////////////////////////////
+
+////////		Writes a table (used by the cooking commandlet)		////////
+bool FTurretPlacementTable::Save(const FString& Filename, const TArray<FTurretPlacementRecord>& InRecords, const TArray<uint16>& InPickUpIndices, const TArray<FString>& InClassPaths)
+{
+	TArray<uint8> File;
+
+	FTurretPlacementHeader Header;
+	FMemory::Memzero(Header);
+	Header.Magic = FileMagic;
+	Header.Version = FileVersion;
+	File.AddZeroed(sizeof(Header));
+
+	// Records start on a 16 byte boundary, which is more than they need to be read in place
+	File.AddZeroed(Align(File.Num(), 16) - File.Num());
+	Header.NumRecords = InRecords.Num();
+	Header.RecordsOffset = File.Num();
+	File.Append(reinterpret_cast<const uint8*>(InRecords.GetData()), InRecords.Num() * sizeof(FTurretPlacementRecord));
+
+	Header.NumPickUpIndices = InPickUpIndices.Num();
+	Header.PickUpIndicesOffset = File.Num();
+	File.Append(reinterpret_cast<const uint8*>(InPickUpIndices.GetData()), InPickUpIndices.Num() * sizeof(uint16));
+
+	Header.NumClassPaths = InClassPaths.Num();
+	Header.ClassPathsOffset = File.Num();
+	for (const FString& ClassPath : InClassPaths)
+	{
+		FTCHARToUTF8 Utf8Path(*ClassPath);
+		File.Append(reinterpret_cast<const uint8*>(Utf8Path.Get()), Utf8Path.Length());
+		File.Add(0);
+	}
+	Header.ClassPathsSize = File.Num() - Header.ClassPathsOffset;
+
+	FMemory::Memcpy(File.GetData(), &Header, sizeof(Header));
+
+	return FFileHelper::SaveArrayToFile(File, *Filename);
+}
+////////////////////////////////////////////////////////////////////////
+
+int32 FTurretPlacementTable::Num() const
+{
+	return NumRecords;
+}
+
+const FTurretPlacementRecord& FTurretPlacementTable::GetRecord(int32 Index) const
+{
+	check(Index >= 0 && Index < NumRecords);
+	return Records[Index];
+}
+
+////////		False if a corrupted record indexes outside the tables		////////
+bool FTurretPlacementTable::IsRecordValid(const FTurretPlacementRecord& Record) const
+{
+	// Checked when the record is used rather than on load, so loading doesn't read every record in the file
+	if (Record.ClassIndex >= ClassPaths.Num() || (uint64)Record.FirstPickUp + Record.NumPickUps > (uint64)NumPickUpIndices)
+	{
+		return false;
+	}
+
+	for (uint16 PickUpIndex : GetPickUpIndices(Record))
+	{
+		if (PickUpIndex >= ClassPaths.Num())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+////////////////////////////////////////////////////////////////////////
+
+TArrayView<const uint16> FTurretPlacementTable::GetPickUpIndices(const FTurretPlacementRecord& Record) const
+{
+	return TArrayView<const uint16>(PickUpIndices + Record.FirstPickUp, Record.NumPickUps);
+}
+
+const TArray<FString>& FTurretPlacementTable::GetClassPaths() const
+{
+	return ClassPaths;
+}
+
+SIZE_T FTurretPlacementTable::GetFileSize() const
+{
+	return FileSize;
+}
+
+bool FTurretPlacementTable::IsMapped() const
+{
+	return MappedRegion.IsValid();
+}
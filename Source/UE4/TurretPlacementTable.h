@@ -0,0 +1,170 @@
+/*
+ *****************************************
+	Crazy Tank - Driving/shooting game prototype
+	By James Romero. Made with Unreal Engine 4
+	2021
+ *****************************************
+ */
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+
+	Engine classes
+
+*/
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+// Settings of a baked Turret that are stored as bits of its record
+enum class ETurretPlacementFlags : uint32
+{
+	None = 0,
+	UseBallisticProjectiles = 1 << 0,
+	UseLightweightPickUps = 1 << 1
+};
+ENUM_CLASS_FLAGS(ETurretPlacementFlags);
+
+// One Turret in a placement table, read straight from the file's memory (it must stay plain data)
+struct FTurretPlacementRecord
+{
+	FVector Location;
+
+	FRotator Rotation;
+
+	FVector Scale;
+
+	float FireRange;
+
+	float FireRate;
+
+	float AimProjectileSpeed;
+
+	float AimTurnRate;
+
+	float MinAimPitch;
+
+	float MaxAimPitch;
+
+	ETurretPlacementFlags Flags;
+
+	uint16 ClassIndex; // Turret class, in the table's class paths
+
+	uint16 NumPickUps;
+
+	uint32 FirstPickUp; // This Turret's first Pick Up class, in the table's Pick Up indices (which index the class paths)
+};
+
+// Start of every placement table file, the offsets are from the start of the file
+struct FTurretPlacementHeader
+{
+	uint32 Magic;
+
+	uint32 Version;
+
+	uint32 NumRecords;
+
+	uint32 RecordsOffset;
+
+	uint32 NumPickUpIndices;
+
+	uint32 PickUpIndicesOffset;
+
+	uint32 NumClassPaths;
+
+	uint32 ClassPathsOffset; // Null-terminated UTF-8 strings, one after the other
+
+	uint32 ClassPathsSize;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//
+// This class reads a cooked Turret placement table (.ctt): every Turret baked out of a map, as plain records.
+// The file is memory-mapped when the platform allows it, so loading costs the same with ten Turrets or ten thousand,
+// and the records are only read (and paged in) when a Turret is about to be spawned
+//
+//////////////////////////////////////////////////////////////////////////////
+class CRAZYTANK_API FTurretPlacementTable
+{
+public:
+
+	/*
+		VARIABLES
+	*/
+
+	static const uint32 FileMagic = 0x54545243; // "CRTT"
+
+	static const uint32 FileVersion = 2;
+
+	/*
+		METHODS
+	*/
+
+	FTurretPlacementTable();
+
+	~FTurretPlacementTable();
+
+	FTurretPlacementTable(const FTurretPlacementTable&) = delete;
+
+	FTurretPlacementTable& operator=(const FTurretPlacementTable&) = delete;
+
+	// Content/TurretPlacement/<Map>.ctt, named after the map's whole package path so same-named maps in other folders get their own table
+	static FString GetTableFilename(const FString& MapPackageName); // e.g. /Game/Maps/Level1 is Game.Maps.Level1.ctt
+
+	bool Load(const FString& Filename); // Maps the file (or reads it, when it can't be mapped) and validates it
+
+	void Unload();
+
+	// Writes a table (used by the cooking commandlet)
+	static bool Save(const FString& Filename, const TArray<FTurretPlacementRecord>& Records, const TArray<uint16>& PickUpIndices, const TArray<FString>& ClassPaths);
+
+	int32 Num() const;
+
+	const FTurretPlacementRecord& GetRecord(int32 Index) const;
+
+	bool IsRecordValid(const FTurretPlacementRecord& Record) const; // False if a corrupted record indexes outside the tables
+
+	TArrayView<const uint16> GetPickUpIndices(const FTurretPlacementRecord& Record) const; // Indices of the Turret's Pick Up classes in the class paths
+
+	const TArray<FString>& GetClassPaths() const;
+
+	SIZE_T GetFileSize() const;
+
+	bool IsMapped() const;
+
+private:
+
+	/*
+		VARIABLES
+	*/
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+
+	TUniquePtr<IMappedFileRegion> MappedRegion; // Declared after MappedFile, the region must be closed before its file
+
+	TArray<uint8> LoadedFile; // Only used when the file couldn't be mapped (e.g. it's inside a pak file)
+
+	const uint8* FileData = nullptr;
+
+	SIZE_T FileSize = 0;
+
+	const FTurretPlacementRecord* Records = nullptr;
+
+	const uint16* PickUpIndices = nullptr;
+
+	int32 NumRecords = 0;
+
+	int32 NumPickUpIndices = 0;
+
+	TArray<FString> ClassPaths; // Only a handful of classes, so they are copied out of the file
+
+	/*
+		METHODS
+	*/
+
+	bool ReadFileData(); // Validates the header and points at the records and indices in FileData
+
+};